@@ -39,6 +39,13 @@ class const_1d : public pdf_Md<T, 1> {
     virtual std::array<T, 1> operator()(std::default_random_engine* rng) {
         return pdf_Md<T, 1>::mean_;
     };
+
+#if !defined(__CUDACC__)
+    /// Returns mean_
+    virtual std::array<T, 1> operator()(mqi::mqi_rng* rng) const { return pdf_Md<T, 1>::mean_; };
+
+    virtual bool samples_on_workers() const { return true; }
+#endif
 };
 
 }  // namespace mqi
@@ -40,6 +40,27 @@ class norm_1d : public pdf_Md<T, 1> {
     /// Returns value sampled from normal distribution
     CUDA_HOST_DEVICE
     virtual std::array<T, 1> operator()(std::default_random_engine* rng) { return {func_(*rng)}; };
+
+    /// Samples n values with batched Box-Muller
+    CUDA_HOST
+    virtual void sample(size_t n, std::default_random_engine* rng, std::array<T*, 1> out) {
+        T* x = out[0];
+        mqi::mqi_standard_normals(rng, x, n);
+        const T mean = pdf_Md<T, 1>::mean_[0];
+        const T sigma = pdf_Md<T, 1>::sigma_[0];
+        for (size_t i = 0; i < n; ++i)
+            x[i] = x[i] * sigma + mean;
+    }
+
+#if !defined(__CUDACC__)
+    /// Returns value sampled from normal distribution with a transport worker's generator
+    virtual std::array<T, 1> operator()(mqi::mqi_rng* rng) const {
+        return {T(mqi::mqi_standard_normal(rng)) * pdf_Md<T, 1>::sigma_[0] +
+                pdf_Md<T, 1>::mean_[0]};
+    };
+
+    virtual bool samples_on_workers() const { return true; }
+#endif
 };
 
 }  // namespace mqi
@@ -16,6 +16,7 @@
 #include <moqui/base/mqi_vec.hpp>
 #include <queue>
 #include <random>
+#include <stdexcept>
 
 namespace mqi {
 
@@ -63,6 +64,28 @@ class pdf_Md {
     /// '()' operator overloading to act like a function.
     CUDA_HOST_DEVICE
     virtual std::array<T, M> operator()(std::default_random_engine* rng) = 0;
+
+    /// Samples n values at once as M columns, out[j][i] is the j-th value of the i-th sample.
+    /// Distributions override it to sample a whole batch, the default samples one by one.
+    CUDA_HOST
+    virtual void sample(size_t n, std::default_random_engine* rng, std::array<T*, M> out) {
+        for (size_t i = 0; i < n; ++i) {
+            const std::array<T, M> v = (*this)(rng);
+            for (size_t j = 0; j < M; ++j)
+                out[j][i] = v[j];
+        }
+    }
+
+#if !defined(__CUDACC__)
+    /// Samples with a counter-based generator of a transport worker.
+    /// It keeps no state in the distribution, so threads can share one distribution.
+    virtual std::array<T, M> operator()(mqi::mqi_rng* rng) const {
+        throw std::runtime_error("Distribution can't be sampled by transport workers.");
+    }
+
+    /// True if the distribution overrides the sampling for transport workers above
+    virtual bool samples_on_workers() const { return false; }
+#endif
 };
 
 }  // namespace mqi
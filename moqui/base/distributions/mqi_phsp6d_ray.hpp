@@ -62,12 +62,93 @@ class phsp_6d_ray : public pdf_Md<T, 6> {
     /// Sample 6 phase-space variables and returns
     CUDA_HOST_DEVICE
     virtual std::array<T, 6> operator()(std::default_random_engine* rng) {
-        std::array<T, 6> phsp = pdf_Md<T, 6>::mean_;
         T Ux = func_(*rng);
         T Vx = func_(*rng);
         T Uy = func_(*rng);
         T Vy = func_(*rng);
         T Uz = func_(*rng);  // T Vz = func_(rng);
+        return this->transform(Ux, Vx, Uy, Vy, Uz);
+    };
+
+#if !defined(__CUDACC__)
+    /// Sample 6 phase-space variables with a transport worker's generator
+    virtual std::array<T, 6> operator()(mqi::mqi_rng* rng) const {
+        T Ux = mqi::mqi_standard_normal(rng);
+        T Vx = mqi::mqi_standard_normal(rng);
+        T Uy = mqi::mqi_standard_normal(rng);
+        T Vy = mqi::mqi_standard_normal(rng);
+        T Uz = mqi::mqi_standard_normal(rng);
+        return this->transform(Ux, Vx, Uy, Vy, Uz);
+    };
+
+    virtual bool samples_on_workers() const { return true; }
+#endif
+
+    /// Samples n phase-space variables at once, column j of out holds variable j.
+    /// Normals of a batch are drawn first and the transform below runs over the columns
+    /// with the per-distribution terms computed once. sin is a shifted cos as in
+    /// mqi_standard_normals so that the loop vectorizes.
+    CUDA_HOST
+    virtual void sample(size_t n, std::default_random_engine* rng, std::array<T*, 6> out) {
+        ///< Ux, Uy, Uz, Vx, Vy are drawn into the columns they are used for
+        for (int j = 0; j < 5; ++j)
+            mqi::mqi_standard_normals(rng, out[j], n);
+
+        const std::array<T, 6>& mean = pdf_Md<T, 6>::mean_;
+        const std::array<T, 6>& sigma = pdf_Md<T, 6>::sigma_;
+        const T z = this->source_position;
+        const T A0_x = rho_[0] * rho_[0];
+        const T A0_y = rho_[1] * rho_[1];
+        const T A2_x = sigma[0] * sigma[0] + 2 * sigma[3] * z + A0_x * z * z;
+        const T A2_y = sigma[1] * sigma[1] + 2 * sigma[4] * z + A0_y * z * z;
+        const T A1_x = sigma[3] + A0_x * z;
+        const T A1_y = sigma[4] + A0_y * z;
+        const T s_x = std::sqrt(A2_x);
+        const T s_y = std::sqrt(A2_y);
+        const T k_x = (A2_x > 0.0) ? s_x * A1_x / A2_x : 0;
+        const T k_y = (A2_y > 0.0) ? s_y * A1_y / A2_y : 0;
+        const T th20_x = (A2_x > 0.0) ? 2 * A0_x - 2.0 * A1_x * A1_x / A2_x : 2 * A0_x;
+        const T th20_y = (A2_y > 0.0) ? 2 * A0_y - 2.0 * A1_y * A1_y / A2_y : 2 * A0_y;
+        const T a_x = std::sqrt(th20_x / 2);
+        const T a_y = std::sqrt(th20_y / 2);
+        const T m_x = mean[0], m_y = mean[1], m_z = mean[2];
+        const T m_u = mean[3], m_v = mean[4], m_w = mean[5];
+        const T s_z = sigma[2];
+
+        ///< Loops touch a few columns each, so the alias checks of the vectorizer stay cheap.
+        ///< Directions go first as they read Ux and Uy.
+        T* x = out[0];
+        T* y = out[1];
+        T* zz = out[2];
+        T* dx = out[3];
+        T* dy = out[4];
+        T* dz = out[5];
+        for (size_t i = 0; i < n; ++i) {
+            T u = m_u + k_x * x[i];
+            T v = m_v + k_y * y[i];
+            const T norm = std::sqrt(u * u + v * v + m_w * m_w);
+            u /= norm;
+            v /= norm;
+            const T t_x = dx[i] * a_x;
+            const T t_y = dy[i] * a_y;
+            u = u * std::cos(t_x) + std::sqrt(1 - u * u) * std::cos(t_x - T(0.5 * M_PI));
+            v = v * std::cos(t_y) + std::sqrt(1 - v * v) * std::cos(t_y - T(0.5 * M_PI));
+            dx[i] = u;
+            dy[i] = v;
+            dz[i] = -std::sqrt(1 - u * u - v * v);
+        }
+        for (size_t i = 0; i < n; ++i)
+            x[i] = m_x + s_x * x[i];
+        for (size_t i = 0; i < n; ++i)
+            y[i] = m_y + s_y * y[i];
+        for (size_t i = 0; i < n; ++i)
+            zz[i] = m_z + s_z * zz[i];
+    }
+
+    /// Phase-space variables from five standard normal values
+    CUDA_HOST_DEVICE
+    std::array<T, 6> transform(T Ux, T Vx, T Uy, T Vy, T Uz) const {
+        std::array<T, 6> phsp = pdf_Md<T, 6>::mean_;
         T z = this->source_position;
         T A0_x = rho_[0] * rho_[0];
         T A1_x = pdf_Md<T, 6>::sigma_[3];
@@ -6,16 +6,21 @@
 #include <cctype>
 #include <chrono>
 #include <ctime>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <moqui/base/environments/mqi_xenvironment.hpp>
 #include <moqui/base/materials/mqi_patient_materials.hpp>
 #include <moqui/base/mqi_aperture.hpp>
 #include <moqui/base/mqi_aperture3d.hpp>
+#include <moqui/base/mqi_contour.hpp>
+#include <moqui/base/mqi_dicom_index.hpp>
 #include <moqui/base/mqi_distributions.hpp>
 #include <moqui/base/mqi_file_handler.hpp>
 #include <moqui/base/mqi_io.hpp>
+#include <moqui/base/mqi_logfile_io.hpp>
 #include <moqui/base/mqi_math.hpp>
 #include <moqui/base/mqi_rangeshifter.hpp>
 #include <moqui/base/mqi_roi.hpp>
@@ -23,12 +28,16 @@
 #include <moqui/base/mqi_treatment_session.hpp>
 #include <moqui/base/scorers/mqi_scorer_energy_deposit.hpp>
 #include <set>
+#include <thread>
+#include <unistd.h>
 #include <valarray>
+#include <vector>
 
 #include "gdcmAttribute.h"
 #include "gdcmDataElement.h"
 #include "gdcmDataSet.h"
 #include "gdcmDict.h"
+#include "gdcmDirectory.h"
 #include "gdcmDicts.h"
 #include "gdcmGlobal.h"
 #include "gdcmIPPSorter.h"
@@ -92,6 +101,10 @@ class tps_env : public x_environment<R> {
     std::string scorer_string;
     mqi::scorer_t scorer_type;
     bool score_variance = false;
+    bool thread_local_scoring = false;  ///< private per-thread dose buffers (CPU, PER_BEAM)
+    int thread_local_scoring_max_mb = 0;  ///< memory limit of the buffers, 0: half of the RAM
+    bool dense_scoring = false;         ///< flat double[] scorer storage (CPU, PER_BEAM)
+    bool on_the_fly_source = false;     ///< workers sample primaries, no vertices (CPU, PER_BEAM)
     std::string source_type = "FluenceMap";
     /// Simulation parameters
     mqi::sim_type_t sim_type;
@@ -99,6 +112,8 @@ class tps_env : public x_environment<R> {
     std::string parent_dir = "";
     std::string dicom_dir = "";
     std::string logfile_dir = "";  // Log file dir added in 2023-11-01
+    bool log_file_cache = false;   // binary cache of parsed log files of each field
+    std::string log_file_cache_dir = "";  // directory of the caches, the field directory if empty
 
     int selectedGantryNumber = 2;    // Basic gantry is G2
     bool usingPhantomGeo = false;    // to use phantom environment, added in 2024-04-11
@@ -139,6 +154,9 @@ class tps_env : public x_environment<R> {
     int verbosity;
     std::string body_contour_name;
     bool read_structure;
+    bool body_culling = false;  ///< air outside of the body contour, cull transport there
+    std::vector<density_t> hu_density;  ///< density of HU -1000 to 6000, built on first use
+    node_t<R>* patient = nullptr;  ///< CT phantom with its ROI and scorer, shared by all beams
     uint32_t scorer_size;
     uint32_t scorer_capacity;
     bool reshape_output = false;
@@ -197,6 +215,8 @@ class tps_env : public x_environment<R> {
                 parser.get_string("logFilePath",
                                   "");  // Log file dir added in 2023-11-01 by Chanil Jeon
         }
+        this->log_file_cache = parser.get_bool("LogFileCache", false);
+        this->log_file_cache_dir = parser.get_string("LogFileCacheDir", "");
 
         //--------------------------------------------------------------------------------------------------
         // Gantry number selection
@@ -256,6 +276,10 @@ class tps_env : public x_environment<R> {
             this->sim_type = mqi::PER_SPOT;
         }
         score_variance = !parser.get_bool("SupressStd", true);
+        thread_local_scoring = parser.get_bool("ThreadLocalScoring", false);
+        thread_local_scoring_max_mb = parser.get_int("ThreadLocalScoringMaxMB", 0);
+        dense_scoring = parser.get_bool("DenseScoring", false);
+        on_the_fly_source = parser.get_bool("OnTheFlySource", false);
         score_to_ct_grid = parser.get_bool("ScoreToCTGrid", true);
         scoring_mask = parser.get_bool("ScoringMask", false);
         ct_clipping = false;  // parser.get_bool("CTClipping", false);
@@ -266,6 +290,13 @@ class tps_env : public x_environment<R> {
         if (this->usingPhantomGeo)
             this->read_structure = false;
 
+        this->body_culling = parser.get_bool("BodyCulling", false);
+        if (this->body_culling && !this->read_structure) {
+            std::cout << "BodyCulling needs ReadStructure with a CT geometry. "
+                      << "Transport outside of the body is not culled." << std::endl;
+            this->body_culling = false;
+        }
+
         if (scoring_mask) {
             save_scorer_map = parser.get_bool("SaveMap", true);
             mask_filenames = parser.get_string_vector("Mask", ",");
@@ -324,6 +355,41 @@ class tps_env : public x_environment<R> {
             throw std::runtime_error("Output directory exists.");
         }
 
+        // --------------------------------------------------
+        /// Dense scorer storage holds one value per voxel, so it only applies to
+        /// voxel-keyed dose/LET scoring written as a full volume
+        if (dense_scoring) {
+#if defined(__CUDACC__)
+            bool dense_supported = false;
+#else
+            bool dense_supported =
+                sim_type == mqi::PER_BEAM && this->reshape_output &&
+                (scorer_type == mqi::DOSE || scorer_type == mqi::LETd || scorer_type == mqi::LETt);
+#endif
+            if (!dense_supported) {
+                std::cout << "DenseScoring requires CPU, perBeam, Dose/LETd/LETt and volume "
+                             "output. Falling back to hash table scoring."
+                          << std::endl;
+                dense_scoring = false;
+            }
+        }
+
+        /// Primaries sampled in the transport workers need the CPU random generator
+        /// and a history index that is not remapped per spot
+        if (on_the_fly_source) {
+#if defined(__CUDACC__)
+            bool on_the_fly_supported = false;
+#else
+            bool on_the_fly_supported = sim_type == mqi::PER_BEAM;
+#endif
+            if (!on_the_fly_supported) {
+                std::cout << "OnTheFlySource requires CPU and perBeam. "
+                             "Falling back to vertex batches."
+                          << std::endl;
+                on_the_fly_source = false;
+            }
+        }
+
         // --------------------------------------------------
         /// Initialize data
         // Reading DICOM CT and RT structure
@@ -404,6 +470,9 @@ class tps_env : public x_environment<R> {
         printf("Log file directory %s\n", logfile_dir.c_str());
         printf("Scorer type %d\n", this->scorer_type);
         printf("Supress variance %d\n", !score_variance);
+        printf("Thread local scoring %d\n", thread_local_scoring);
+        printf("Dense scoring %d\n", dense_scoring);
+        printf("On-the-fly source %d\n", on_the_fly_source);
         printf("Particles per histories %.1f\n", particles_per_history);
         printf("Source type %s\n", source_type.c_str());
         printf("Simulation type %d\n", sim_type);
@@ -442,49 +511,19 @@ class tps_env : public x_environment<R> {
     virtual struct dicom_t read_dcm_dir() {
         // Declare DICOM dataset variable
         dicom_t dcm;
-        gdcm::Directory d;
-        //// Need to check the directory is valid and stop process if not
-        d.Load(dicom_dir.c_str());
-
-        // Fix: Use custom file discovery instead of GDCM Directory::Explore()
-        std::vector<std::string> dicom_files;
-        std::string find_cmd = "find '" + dicom_dir + "' -maxdepth 1 -name '*.dcm' 2>/dev/null";
-
-        FILE* pipe = popen(find_cmd.c_str(), "r");
-        if (pipe) {
-            char buffer[256];
-            while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-                std::string file_path = buffer;
-                if (!file_path.empty() && file_path.back() == '\n') {
-                    file_path.pop_back();  // Remove newline
-                }
-                if (!file_path.empty()) {
-                    dicom_files.push_back(file_path);
-                }
-            }
-            pclose(pipe);
-        }
+
+        // Read each header once; the catalogue is shared with the CT loader
+        mqi::dicom_index index(dicom_dir);
 
         std::cout << "Reading DICOM directory.. : DICOM directory name --> " << dicom_dir
                   << std::endl;
-        std::cout << "Found " << dicom_files.size() << " DICOM files" << std::endl;
+        std::cout << "Found " << index.entries().size() << " DICOM files" << std::endl;
 
-        if (dicom_files.empty()) {
+        if (index.entries().empty()) {
             throw std::runtime_error("No DICOM files found in directory: " + dicom_dir);
         }
 
-        dcm.nfiles = dicom_files.size();
-        gdcm::Scanner s0;
-
-        // Reading modality tag of DICOM
-        const gdcm::Tag Modality(0x0008, 0x0060);  // Modality
-        s0.AddTag(Modality);
-        bool b = s0.Scan(dicom_files);
-        if (!b) {
-            std::cerr << "Scanner failed" << std::endl;
-            throw std::runtime_error("Reading DICOM failed.");
-            //            return;
-        }
+        dcm.nfiles = index.entries().size();
 
         // ----------------------------------------------------------------------------------------------------------
         // Only get the DICOM files:
@@ -492,38 +531,17 @@ class tps_env : public x_environment<R> {
         // DICOM RT Struct : for CT masking ROI
         // DICOM CT : for patient geometry
 
-        dcm.plan_list = s0.GetAllFilenamesFromTagToValue(Modality, "RTPLAN");
-        dcm.struct_list = s0.GetAllFilenamesFromTagToValue(Modality, "RTSTRUCT");
+        dcm.plan_list = index.files("RTPLAN");
+        dcm.struct_list = index.files("RTSTRUCT");
 
         // If user don't use phantom geometry, load DICOM CT files
         if (!this->usingPhantomGeo) {
             std::cout << "Patient geometry mode: Loading CT data..." << std::endl;
 
             // Check if CT files exist before attempting to load
-            std::vector<std::string> ct_files;
-            for (const auto& file : dicom_files) {
-                // Use filename pattern to detect CT files (simple approach)
-                std::string filename = file.substr(file.find_last_of("/\\") + 1);
-                std::transform(filename.begin(), filename.end(), filename.begin(), ::toupper);
-
-                // Common CT file naming patterns
-                if (filename.find("CT") != std::string::npos ||
-                    filename.rfind(".DCM", filename.length() - 4) != std::string::npos) {
-                    // Additional check using GDCM to read modality tag
-                    gdcm::Reader reader;
-                    reader.SetFileName(file.c_str());
-                    if (reader.Read()) {
-                        gdcm::StringFilter sf;
-                        sf.SetFile(reader.GetFile());
-                        std::string modality = sf.ToStringPair(gdcm::Tag(0x0008, 0x0060)).second;
-                        if (modality == "CT") {
-                            ct_files.push_back(file);
-                        }
-                    }
-                }
-            }
+            dcm.ct_list = index.files("CT");
 
-            if (ct_files.empty()) {
+            if (dcm.ct_list.empty()) {
                 std::cerr << "ERROR: Dicom CT data is not loaded" << std::endl;
                 std::cerr << "No CT files found in directory: " << dicom_dir << std::endl;
                 std::cerr << "Please ensure CT DICOM files are present or use UsingPhantomGeo true"
@@ -531,9 +549,9 @@ class tps_env : public x_environment<R> {
                 throw std::runtime_error("Dicom CT data is not loaded - No CT files found");
             }
 
-            std::cout << "Found " << ct_files.size() << " CT files, loading CT data..."
+            std::cout << "Found " << dcm.ct_list.size() << " CT files, loading CT data..."
                       << std::endl;
-            dcm.ct = new mqi::ct<R>(dicom_dir, false);
+            dcm.ct = new mqi::ct<R>(index, false);
             dcm.ct->load_data();
 
             // Get geometry information from CT
@@ -712,11 +730,13 @@ class tps_env : public x_environment<R> {
                 }
             }
             auto roi_contour_seq = (*struct_ds_)(gdcm::Tag(0x3006, 0x0039));
-            uint8_t* body_contour = new uint8_t[dcm.org_dim_.x * dcm.org_dim_.y * dcm.org_dim_.z];
+            const size_t nb_voxels = dcm.org_dim_.x * dcm.org_dim_.y * dcm.org_dim_.z;
+            uint8_t* body_contour = new uint8_t[nb_voxels];
+            std::memset(body_contour, 0, nb_voxels * sizeof(uint8_t));
             std::vector<int> refer_roi, contour_num;
             std::vector<float> contour_data;
-            mqi::vec3<float>* contour_points;
-            int points_ind;
+            ///< contours of the body ROI grouped by CT slice
+            std::vector<std::vector<std::vector<mqi::vec2<float>>>> slice_contours(dcm.dim_.z);
             // start = std::chrono::high_resolution_clock::now();
             for (int con_ind = 0; con_ind < roi_contour_seq.size(); con_ind++) {
                 roi_contour_seq[con_ind]->get_values("ReferencedROINumber", refer_roi);
@@ -725,19 +745,22 @@ class tps_env : public x_environment<R> {
                     for (int contour_ind = 0; contour_ind < contour_seq.size(); contour_ind++) {
                         contour_seq[contour_ind]->get_values("NumberOfContourPoints", contour_num);
                         contour_seq[contour_ind]->get_values("ContourData", contour_data);
-                        contour_points = new mqi::vec3<float>[contour_num[0]];
-                        for (points_ind = 0; points_ind < contour_num[0]; points_ind++) {
-                            contour_points[points_ind].x = contour_data[points_ind * 3];
-                            contour_points[points_ind].y = contour_data[points_ind * 3 + 1];
-                            contour_points[points_ind].z = contour_data[points_ind * 3 + 2];
+                        if (contour_num[0] < 1)
+                            continue;
+                        int z_ind = contour_slice_index(contour_data[2], dcm.dim_, dcm.ze);
+                        if (z_ind < 0)
+                            continue;
+                        std::vector<mqi::vec2<float>> contour(contour_num[0]);
+                        for (int points_ind = 0; points_ind < contour_num[0]; points_ind++) {
+                            contour[points_ind].x = contour_data[points_ind * 3];
+                            contour[points_ind].y = contour_data[points_ind * 3 + 1];
                         }
-                        fill_contour(body_contour, contour_points, contour_num[0], dcm.dim_, dcm.xe,
-                                     dcm.ye, dcm.ze, dcm.dx, dcm.dy);
-                        delete[] contour_points;
+                        slice_contours[z_ind].push_back(std::move(contour));
                     }
                     break;
                 }
             }
+            fill_contours(body_contour, slice_contours, dcm.dim_, dcm.xe, dcm.ye, dcm.dx, dcm.dy);
             // stop     = std::chrono::high_resolution_clock::now();
             // duration = stop - start;
             // printf("Contour conversion to volume: %f ms\n", duration.count());
@@ -792,50 +815,49 @@ class tps_env : public x_environment<R> {
                     sortedByName.push_back(entry.path());
                 std::sort(sortedByName.begin(), sortedByName.end());
 
+                // Only csv files are layer log files
+                std::vector<std::filesystem::path> layerFiles;
                 for (auto& filename : sortedByName) {
-                    // Check the reading files are csv
                     if (filename.extension() == ".csv") {
-                        // Reading each log file data
-                        std::fstream fs(filename.string());
-                        std::string strBuf;
-
-                        // Get beam energy from file name string
-                        std::string logBeamEnergyString = filename.filename().string();
-                        logBeamEnergyString =
-                            logBeamEnergyString.substr(0, logBeamEnergyString.find('.csv') - 1);
-                        logBeamEnergyString = logBeamEnergyString.substr(
-                            logBeamEnergyString.find('_') + 1, logBeamEnergyString.find('M') - 2);
-                        float layerBeamEnergy = std::stof(logBeamEnergyString);
-                        fieldBeamEnergy.push_back(layerBeamEnergy);
-
                         std::cout << "Reading log file information in the field directory.. : " +
                                          filename.string() + ".."
                                   << std::endl;
-
-                        // Declare variable of a log file
-                        logfile_t selectedLogFiledInfo;
-
-                        int csvIndex = 0;
-
-                        while (!fs.eof()) {
-                            if (std::getline(fs, strBuf, ',')) {
-                                csvIndex += 1;  // Add csv index
-
-                                if (csvIndex == 2)
-                                    selectedLogFiledInfo.posX.push_back(stof(strBuf));
-                                else if (csvIndex == 3)
-                                    selectedLogFiledInfo.posY.push_back(stof(strBuf));
-                                else if (csvIndex == 4) {
-                                    selectedLogFiledInfo.muCount.push_back(
-                                        stoi(strBuf) * this->particles_per_history);
-                                    csvIndex = 0;
-                                }
-                            }
-                        }
-                        fs.close();
-                        fieldLogFileContainer.push_back(selectedLogFiledInfo);
+                        layerFiles.push_back(filename);
                     }
                 }
+
+                // Parsed layers are cached per field, keyed by the names, sizes and
+                // modification times of the csv files. The log directory is often read-only
+                // or shared, so the cache can be kept in LogFileCacheDir instead.
+                bool cacheLoaded = false;
+                uint64_t logHash = 0;
+                std::string cacheFile = (p / "logfile_cache.bin").string();
+                if (this->log_file_cache && !this->log_file_cache_dir.empty()) {
+                    std::error_code ec;
+                    std::filesystem::create_directories(this->log_file_cache_dir, ec);
+                    cacheFile = (std::filesystem::path(this->log_file_cache_dir) /
+                                 (p.filename().string() + "_logfile_cache.bin"))
+                                    .string();
+                }
+                if (this->log_file_cache) {
+                    logHash = mqi::io::hash_log_files(layerFiles, this->particles_per_history);
+                    cacheLoaded = mqi::io::read_log_cache(cacheFile, logHash,
+                                                          fieldLogFileContainer, fieldBeamEnergy);
+                    if (cacheLoaded)
+                        std::cout << "Reading log file information from cache.. : " + cacheFile
+                                  << std::endl;
+                }
+
+                // Layers are parsed in parallel, energies come from the file names
+                if (!cacheLoaded) {
+                    mqi::io::read_log_field(layerFiles, this->particles_per_history,
+                                            fieldLogFileContainer, fieldBeamEnergy);
+                    if (this->log_file_cache &&
+                        !mqi::io::write_log_cache(cacheFile, logHash, fieldLogFileContainer,
+                                                  fieldBeamEnergy))
+                        std::cout << "Warning: can't write log file cache " + cacheFile
+                                  << std::endl;
+                }
                 logFileData.beamInfo.push_back(fieldLogFileContainer);
                 logFileData.beamEnergyInfo.push_back(fieldBeamEnergy);
 
@@ -857,6 +879,7 @@ class tps_env : public x_environment<R> {
 
     CUDA_HOST
     virtual void setup_world() {
+        this->release_world();
         this->world = new mqi::node_t<R>;
         ///< By default, let's set +- 40 cm as world volume
         //		const R hl   = 600.0;
@@ -904,7 +927,7 @@ class tps_env : public x_environment<R> {
             beamline_geometries.size() + 1 +
             worldChildCorrection;  // Original is + 1. Additional + 1 for air box
         this->world->children =
-            new node_t<R>*[this->world->n_children];  // Beam line geometry + airbox
+            new node_t<R>*[this->world->n_children]();  // Beam line geometry + airbox
 
         ///< Create beamline objects
         mqi::coordinate_transform<R> p_coord = this->tx->get_coordinate(bnb);
@@ -945,12 +968,10 @@ class tps_env : public x_environment<R> {
             else
                 airEndPos = this->phantomPositionZ + this->phantomDimZ * phantomUnitZ;
 
-            airBox->geo =
-                new grid3d<density_t, R>(-200, 200, 2, -200, 200, 2, airEndPos,
-                                         snoutPos[0],  // Snout position - gap for calculation
-                                         2,            // int((snoutPos[0] - (airEndPos)) / 2) + 1,
-                                         p_coord.rotation);
-            airBox->geo->fill_data(mqi::air_t<R>().rho_mass);  // Fill volume with air
+            airBox->geo = this->create_homogeneous_box(
+                -200, 200, -200, 200, airEndPos,
+                snoutPos[0],  // Snout position - gap for calculation
+                mqi::air_t<R>().rho_mass, p_coord.rotation);  // Fill volume with air
 
             // Air box has no scorer and children
             airBox->n_scorers = 0;
@@ -975,6 +996,15 @@ class tps_env : public x_environment<R> {
             this->world->children[i] = beamline_objects[i];
         }
 
+        ///< CT phantom doesn't depend on the beam, reuse the one of the previous beam
+        if (!this->usingPhantomGeo && this->patient != nullptr) {
+            std::cout << "Reusing patient geometry, ROI and scorer of the previous beam.."
+                      << std::endl;
+            this->world->children[beamline_geometries.size()] = this->patient;
+            this->reset_scorers(this->patient);
+            return;
+        }
+
         ///< create a child
         std::cout << "Creating child in world geometry.. : Phantom size -->" << std::endl;
         if (this->twoCentimeterMode)
@@ -994,10 +1024,15 @@ class tps_env : public x_environment<R> {
             phantom->geo = new grid3d<density_t, R>(this->dcm_.xe, this->dcm_.dim_.x + 1,
                                                     this->dcm_.ye, this->dcm_.dim_.y + 1,
                                                     this->dcm_.ze, this->dcm_.dim_.z + 1);
-            density_t* rho_mass = new density_t[dcm_.dim_.x * dcm_.dim_.y * dcm_.dim_.z];
+            const size_t nb_voxels = size_t(dcm_.dim_.x) * dcm_.dim_.y * dcm_.dim_.z;
+            density_t* rho_mass = new density_t[nb_voxels];
             std::cout << "Creating material information for grid.." << std::endl;
-            for (int i = 0; i < dcm_.dim_.x * dcm_.dim_.y * dcm_.dim_.z; i++) {
-                rho_mass[i] = this->tx->material_.hu_to_density(this->ct_data[i]);
+            this->convert_hu_to_density(this->ct_data, rho_mass, nb_voxels);
+            if (this->body_culling) {
+                std::cout << "Overriding density outside of " << this->body_contour_name
+                          << " with air.." << std::endl;
+                phantom->body_mask =
+                    this->create_body_mask(this->dcm_.body_contour, *phantom->geo, rho_mass);
             }
             phantom->geo->set_data(rho_mass);  //// Material conversion function required
         } else                                 // 2. If user uses phantom geometry
@@ -1015,14 +1050,9 @@ class tps_env : public x_environment<R> {
             if (this->twoCentimeterMode) {
                 // Front phantom
                 this->world->children[beamline_geometries.size() + 1] = frontPhantom;
-                frontPhantom->geo = new grid3d<density_t, R>(-200, 200, 401, -200, 200, 401, 1, 20,
-                                                             2, transformPhantom.rotation);
-
-                density_t* rho_mass_parent1 = new density_t[400 * 400 * 1];
-                for (int i = 0; i < 400 * 400 * 1; i++) {
-                    rho_mass_parent1[i] = mqi::h2o_t<R>().rho_mass;  // Water
-                }
-                frontPhantom->geo->set_data(rho_mass_parent1);
+                frontPhantom->geo = this->create_homogeneous_box(
+                    -200, 200, -200, 200, 1, 20, mqi::h2o_t<R>().rho_mass,  // Water
+                    transformPhantom.rotation);
 
                 this->world->children[beamline_geometries.size() + 2] = phantom;
                 phantom->geo = new grid3d<density_t, R>(-200, 200, 401, -200, 200, 401, -1, 1, 4,
@@ -1037,14 +1067,9 @@ class tps_env : public x_environment<R> {
 
                 // Back phantom
                 this->world->children[beamline_geometries.size() + 3] = backPhantom;
-                backPhantom->geo = new grid3d<density_t, R>(-200, 200, 401, -200, 200, 401, -380,
-                                                            -1, 2, transformPhantom.rotation);
-
-                density_t* rho_mass_parent2 = new density_t[400 * 400 * 189];
-                for (int i = 0; i < 400 * 400 * 189; i++) {
-                    rho_mass_parent2[i] = mqi::h2o_t<R>().rho_mass;  // Water
-                }
-                backPhantom->geo->set_data(rho_mass_parent2);
+                backPhantom->geo = this->create_homogeneous_box(
+                    -200, 200, -200, 200, -380, -1, mqi::h2o_t<R>().rho_mass,  // Water
+                    transformPhantom.rotation);
             } else {
                 this->world->children[beamline_geometries.size() + 1] = phantom;
                 phantom->geo = new grid3d<density_t, R>(
@@ -1116,13 +1141,19 @@ class tps_env : public x_environment<R> {
         }
         phantom->scorers[0] = new mqi::scorer<R>(this->scorer_string.c_str(), scorer_size, fp0);
 
-        mqi::key_value* deposit0 = new mqi::key_value[phantom->scorers[0]->max_capacity_];
+        if (this->dense_scoring) {
+            ///< no key table, transport adds directly to dense_data_[cnb]
+            phantom->scorers[0]->dense_data_ = new double[phantom->scorers[0]->max_capacity_]();
+        } else {
+            mqi::key_value* deposit0 = new mqi::key_value[phantom->scorers[0]->max_capacity_];
 
-        std::memset(deposit0, 0xff, sizeof(mqi::key_value) * phantom->scorers[0]->max_capacity_);
+            std::memset(deposit0, 0xff,
+                        sizeof(mqi::key_value) * phantom->scorers[0]->max_capacity_);
 
-        init_table(deposit0, phantom->scorers[0]->max_capacity_);
+            init_table(deposit0, phantom->scorers[0]->max_capacity_);
 
-        phantom->scorers[0]->data_ = deposit0;
+            phantom->scorers[0]->data_ = deposit0;
+        }
         phantom->scorers[0]->score_variance_ = this->score_variance;
         phantom->scorers[0]->roi_ = roi_tmp;
 
@@ -1142,6 +1173,52 @@ class tps_env : public x_environment<R> {
         }
 
         mc::mc_score_variance = this->score_variance;
+        if (!this->usingPhantomGeo)
+            this->patient = phantom;
+    }
+
+    /// Clears scored values of a node so that it can be scored again
+    CUDA_HOST
+    void reset_scorers(node_t<R>* node) {
+        for (uint16_t s = 0; s < node->n_scorers; ++s) {
+            mqi::scorer<R>* scr = node->scorers[s];
+            if (scr->dense_data_ != nullptr) {
+                std::memset(scr->dense_data_, 0, sizeof(double) * scr->max_capacity_);
+            } else {
+                init_table(scr->data_, scr->max_capacity_);
+            }
+            if (scr->score_variance_) {
+                init_table(scr->count_, scr->max_capacity_);
+                init_table(scr->mean_, scr->max_capacity_);
+                init_table(scr->variance_, scr->max_capacity_);
+            }
+        }
+    }
+
+    /// Deletes the world of the previous beam, except the shared patient node
+    CUDA_HOST
+    void release_world() {
+        if (this->world == nullptr)
+            return;
+        for (uint16_t c = 0; c < this->world->n_children; ++c) {
+            node_t<R>* child = this->world->children[c];
+            if (child == nullptr || child == this->patient)
+                continue;
+            for (uint16_t s = 0; s < child->n_scorers; ++s)
+                delete child->scorers[s];
+            delete[] child->scorers;
+            if (child->geo != nullptr) {
+                child->geo->delete_data_if_used();
+                delete child->geo;
+            }
+            delete child->body_mask;
+            delete child;
+        }
+        delete[] this->world->children;
+        this->world->geo->delete_data_if_used();
+        delete this->world->geo;
+        delete this->world;
+        this->world = nullptr;
     }
 
     // Beam source loading code
@@ -1266,7 +1343,9 @@ class tps_env : public x_environment<R> {
     CUDA_HOST
     virtual void run_simulation(size_t histories_per_batch, size_t histories_in_batch,
                                 uint32_t* tracked_particles,
-                                uint32_t* scorer_offset_vector = nullptr) {
+                                uint32_t* scorer_offset_vector = nullptr,
+                                size_t first_history = 0,
+                                const mqi::beamsource<R>* source = nullptr) {
         /// histories_per_batch and histories_in_batch are kine of redundant.
         /// the histories_per_batch may not required if copying memory work correctly with
         /// histories_in_batch
@@ -1350,15 +1429,108 @@ class tps_env : public x_environment<R> {
         gpu_err_chk(cudaFree(worker_threads));
         gpu_err_chk(cudaFree(mc::mc_vertices));
 #else
-        n_threads = 1;
+        ///< TotalThreads <= 0 uses all hardware threads of the host
+        if (this->num_total_threads > 0) {
+            n_threads = this->num_total_threads;
+        } else {
+            n_threads = std::thread::hardware_concurrency();
+        }
+        if (n_threads < 1)
+            n_threads = 1;
+        if (histories_in_batch > 0 && histories_in_batch < n_threads)
+            n_threads = histories_in_batch;
         mc::mc_vertices = this->vertices;
         mc::mc_world = this->world;
-        /// TODO: number of threads for multithreading implementation
+        ///< private dense accumulators only apply to voxel-keyed (PER_BEAM) scoring
+        bool use_thread_data = this->thread_local_scoring && scorer_offset_vector == nullptr;
+        ///< each worker gets a full copy of every scorer, e.g., 630 MB for a 512x512x300 CT,
+        ///< so the buffers are not used when they don't fit into the memory limit
+        if (use_thread_data) {
+            size_t bytes = 0;
+            for (uint32_t c = 0; c < this->world->n_children; ++c) {
+                for (uint8_t s = 0; s < this->world->children[c]->n_scorers; ++s) {
+                    bytes += this->world->children[c]->scorers[s]->thread_data_bytes(n_threads);
+                }
+            }
+            size_t limit;
+            if (this->thread_local_scoring_max_mb > 0) {
+                limit = size_t(this->thread_local_scoring_max_mb) << 20;
+            } else {
+                limit = size_t(sysconf(_SC_PHYS_PAGES)) * size_t(sysconf(_SC_PAGE_SIZE)) / 2;
+            }
+            if (bytes > limit) {
+                printf("Thread local scoring needs %zu MB for %u threads, more than %zu MB. "
+                       "Scoring with atomics instead.\n",
+                       bytes >> 20, n_threads, limit >> 20);
+                use_thread_data = false;
+            }
+        }
+        for (uint32_t c = 0; c < this->world->n_children; ++c) {
+            for (uint8_t s = 0; s < this->world->children[c]->n_scorers; ++s) {
+                if (use_thread_data) {
+                    this->world->children[c]->scorers[s]->allocate_thread_data(n_threads);
+                } else {
+                    this->world->children[c]->scorers[s]->delete_thread_data();
+                }
+            }
+        }
         worker_threads = new mqi::thrd_t[n_threads];
-        initialize_threads(worker_threads, n_threads, this->master_seed);
-        printf("Thread initialization complete!\n");
-        mc::transport_particles_patient<R>(worker_threads, mc::mc_world, mc::mc_vertices,
-                                           histories_in_batch, tracked_particles);
+        initialize_threads(worker_threads, n_threads, this->master_seed, this->bnb);
+        for (uint32_t i = 0; i < n_threads; ++i) {
+            worker_threads[i].histories[0] = first_history;
+            worker_threads[i].histories[1] = first_history + histories_in_batch;
+        }
+        printf("Thread initialization complete! : Thread size --> %d\n", n_threads);
+        std::vector<std::thread> workers;
+        workers.reserve(n_threads);
+        if (scorer_offset_vector) {
+            ///< PER_SPOT: spot history counts differ by orders of magnitude, so workers take
+            ///< (spot, history chunk) tasks from a work-stealing queue instead of fixed slices.
+            ///< About 16 chunks per worker balance the tail, and a spot is not cut below
+            ///< min_spot_chunk histories so that its Dij column stays with few workers.
+            const uint32_t min_spot_chunk = 256;
+            const uint32_t chunk =
+                std::max<uint32_t>(min_spot_chunk, histories_in_batch / (16 * n_threads));
+            mqi::task_queue queue(
+                mqi::make_spot_tasks(scorer_offset_vector, histories_in_batch, chunk), n_threads);
+            for (uint32_t i = 0; i < n_threads; ++i) {
+                workers.emplace_back(mc::transport_particles_patient_tasks<R>, worker_threads,
+                                     mc::mc_world, mc::mc_vertices, &queue, tracked_particles,
+                                     scorer_offset_vector, true, i, source);
+            }
+            for (auto& w : workers) {
+                w.join();
+            }
+        } else {
+            ///< each worker transports its own contiguous range of histories,
+            ///< see mqi::start_and_length
+            for (uint32_t i = 0; i < n_threads; ++i) {
+                workers.emplace_back(mc::transport_particles_patient<R>, worker_threads,
+                                     mc::mc_world, mc::mc_vertices, histories_in_batch,
+                                     tracked_particles, scorer_offset_vector, true, n_threads, i,
+                                     source);
+            }
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+        if (use_thread_data) {
+            for (uint32_t c = 0; c < this->world->n_children; ++c) {
+                for (uint8_t s = 0; s < this->world->children[c]->n_scorers; ++s) {
+                    mqi::scorer<R>* scr = this->world->children[c]->scorers[s];
+                    workers.clear();
+                    for (uint32_t i = 0; i < n_threads; ++i) {
+                        workers.emplace_back(mc::reduce_thread_data<R>, scr,
+                                             scr->n_thread_data_, n_threads, i);
+                    }
+                    for (auto& w : workers) {
+                        w.join();
+                    }
+                }
+            }
+        }
+        printf("Transportation call ended!\n");
+        delete[] worker_threads;
 #endif
     }  // run_simulation
 
@@ -1367,9 +1539,10 @@ class tps_env : public x_environment<R> {
                             std::tuple<mqi::beamlet<R>, size_t, size_t> bl,
                             mqi::vertex_t<R>* vertices, uint32_t* score_offset_vector, int spot_ind,
                             size_t histories_per_batch) {
+        std::vector<R> scratch(7 * (history_end - history_start));
+        std::get<0>(bl).sample(history_end - history_start, &this->beam_rng,
+                               vertices + history_start, scratch.data());
         for (int history_ind = history_start; history_ind < history_end; history_ind++) {
-            vertices[history_ind] = std::get<0>(bl)(&this->beam_rng);
-
             score_offset_vector[history_ind] =
                 spot_ind * this->scorer_size;  // Store beamlet index for each history
             assert(history_ind < histories_per_batch);
@@ -1386,6 +1559,32 @@ class tps_env : public x_environment<R> {
         uint32_t* tracked_particles = new uint32_t[1];
         tracked_particles[0] = 0;
 
+#if !defined(__CUDACC__)
+        ///< Only some distributions can be sampled by the workers, see pdf_Md::samples_on_workers.
+        ///< CUDA builds never enable on_the_fly_source.
+        bool on_the_fly = this->on_the_fly_source;
+        if (on_the_fly && !this->beamsource.samples_on_workers()) {
+            std::cout << "OnTheFlySource needs beam model distributions that transport workers "
+                         "can sample. Falling back to vertex batches."
+                      << std::endl;
+            on_the_fly = false;
+        }
+        if (on_the_fly) {
+            ///< Workers sample the primary of history h from the beamlet containing h,
+            ///< so the whole beam is one run without vertices.
+            ///< History indices of a run are 32-bit, see mqi::thrd_t.
+            if (h1 - h0 > std::numeric_limits<uint32_t>::max())
+                throw std::runtime_error("OnTheFlySource supports up to 2^32-1 histories.");
+            printf("Transporting particles sampled on the fly.. : Particle count --> %lu\n",
+                   h1 - h0);
+            this->vertices = nullptr;
+            run_simulation(0, h1 - h0, tracked_particles, nullptr, h0, &this->beamsource);
+            std::cout << "Particle transportation complete!" << std::endl;
+            delete[] tracked_particles;
+            return;
+        }
+#endif
+
         int num_batches;
         size_t histories_per_batch = 0, cum_vertices = 0;
         size_t current_vertex = 0;
@@ -1400,28 +1599,59 @@ class tps_env : public x_environment<R> {
             std::cout << "Uploading particles with batch.. : Particle count --> "
                       << histories_per_batch << " with " << num_batches << " batches" << std::endl;
         }
+        ///< Vertices of the next batch are sampled by a producer thread into the other buffer
+        ///< while the current batch is transported. Sampling stays sequential on beam_rng,
+        ///< so the vertices are the same as sampling batch by batch.
+        mqi::vertex_t<R>* buffers[2] = {new mqi::vertex_t<R>[histories_per_batch], nullptr};
+        if (num_batches > 1)
+            buffers[1] = new mqi::vertex_t<R>[histories_per_batch];
+        auto sample_batch = [&](size_t first, mqi::vertex_t<R>* dst) -> size_t {
+            if (first >= h1 - h0)
+                return 0;
+            const size_t n = std::min(histories_per_batch, (h1 - h0) - first);
+            this->beamsource.sample(first, n, &this->beam_rng, dst);  // spot by spot batches
+            return n;
+        };
+
+        printf("Generating particles for (1 of %d batches) in CPU ..\n", num_batches);
+        size_t next_vertices = sample_batch(0, buffers[0]);
         for (int batch = 0; batch < num_batches; batch++) {
-            this->vertices = new mqi::vertex_t<R>[histories_per_batch];
-            printf("Generating particles for (%d of %d batches) in CPU ..\n", batch + 1,
-                   num_batches);
-            for (current_vertex = 0; current_vertex < histories_per_batch; current_vertex++) {
-                if (cum_vertices + current_vertex >= (h1 - h0)) {
-                    break;
-                }
-                auto bl = this->beamsource(cum_vertices + current_vertex);
-                this->vertices[current_vertex] = bl(&this->beam_rng);  // copy histories to vertices
+            current_vertex = next_vertices;
+            this->vertices = buffers[batch % 2];
+            std::cout << "Particle generation complete!" << std::endl;
+
+            std::thread producer;
+            std::exception_ptr producer_error;
+            if (batch + 1 < num_batches) {
+                printf("Generating particles for (%d of %d batches) in CPU ..\n", batch + 2,
+                       num_batches);
+                producer = std::thread([&, batch]() {
+                    try {
+                        next_vertices = sample_batch(cum_vertices + current_vertex,
+                                                     buffers[(batch + 1) % 2]);
+                    } catch (...) {
+                        producer_error = std::current_exception();
+                    }
+                });
             }
 
-            std::cout << "Particle generation complete!" << std::endl;
-            cum_vertices += current_vertex;
             printf("Transporting particles...\n");
-            run_simulation(histories_per_batch, current_vertex, tracked_particles);
+            run_simulation(histories_per_batch, current_vertex, tracked_particles, nullptr,
+                           cum_vertices);
+            if (producer.joinable())
+                producer.join();
+            if (producer_error)
+                std::rethrow_exception(producer_error);
+            cum_vertices += current_vertex;
             std::cout << "Particle transportation complete!" << std::endl;
-            delete[] this->vertices;
             if (tracked_particles[0] == h1) {
                 break;
             }
         }
+        delete[] buffers[0];
+        delete[] buffers[1];
+        this->vertices = nullptr;
+        delete[] tracked_particles;
 
     }  // run_by_beam
 
@@ -1472,6 +1702,7 @@ class tps_env : public x_environment<R> {
             //            spot_start);
             start = std::chrono::high_resolution_clock::now();
             printf("Generating particles..\n");
+            const size_t batch_first_history = cum_vertices;
             for (spot_ind = spot_start; spot_ind < this->num_spots; spot_ind++) {
                 auto bl = this->beamsource[spot_ind];
                 num_histories = std::get<1>(bl);
@@ -1511,7 +1742,7 @@ class tps_env : public x_environment<R> {
             printf("Transporting particles..\n");
             start = std::chrono::high_resolution_clock::now();
             run_simulation(histories_per_batch, current_vertex, tracked_particles,
-                           score_offset_vector);
+                           score_offset_vector, batch_first_history);
             stop = std::chrono::high_resolution_clock::now();
             duration = stop - start;
             printf("run simulation %f ms\n", duration.count());
@@ -1529,6 +1760,19 @@ class tps_env : public x_environment<R> {
 
     }  // run_by_spot
 
+    /// Creates a box of a single density.
+    /// The box is a single voxel, so intersect gives the distance to
+    /// the outer surface and steps inside are limited only by physics.
+    CUDA_HOST
+    mqi::grid3d<mqi::density_t, R>* create_homogeneous_box(R x0, R x1, R y0, R y1, R z0, R z1,
+                                                           mqi::density_t rho_mass,
+                                                           mqi::mat3x3<R> rotation) {
+        mqi::grid3d<mqi::density_t, R>* box =
+            new grid3d<mqi::density_t, R>(x0, x1, 2, y0, y1, 2, z0, z1, 2, rotation);
+        box->fill_data(rho_mass);
+        return box;
+    }
+
     virtual mqi::node_t<R>* create_rangeshifter(mqi::rangeshifter* geometry,
                                                 mqi::coordinate_transform<R> p_coord) {
         mqi::node_t<R>* rangeshifter = new mqi::node_t<R>;
@@ -1554,17 +1798,15 @@ class tps_env : public x_environment<R> {
         std::cout << "Printing rangeshifter specification.. : Volume -->" << std::endl;
         geometry->volume.dump();
         std::cout << "Creating rangeshifter grid.." << std::endl;
-        rangeshifter->geo = new grid3d<mqi::density_t, R>(
-            geometry->pos.x - geometry->volume.x / 2, geometry->pos.x + geometry->volume.x / 2, 2,
-            geometry->pos.y - geometry->volume.y / 2, geometry->pos.y + geometry->volume.y / 2, 2,
-            geometry->pos.z - geometry->volume.z / 2, geometry->pos.z + geometry->volume.z / 2, 2,
-            p_final.rotation);
-
         std::cout << "Filling rangeshifter grid with specific density.." << std::endl;
         /// TODO: Check material and density of rangeshifter
         // For SMC, 4 cm of solid water phantom is range shifter.
         // 39.37 mm is water-equivalent length
-        rangeshifter->geo->fill_data(mqi::h2o_t<R>().rho_mass);  // Water
+        rangeshifter->geo = this->create_homogeneous_box(
+            geometry->pos.x - geometry->volume.x / 2, geometry->pos.x + geometry->volume.x / 2,
+            geometry->pos.y - geometry->volume.y / 2, geometry->pos.y + geometry->volume.y / 2,
+            geometry->pos.z - geometry->volume.z / 2, geometry->pos.z + geometry->volume.z / 2,
+            mqi::h2o_t<R>().rho_mass, p_final.rotation);  // Water
         rangeshifter->geo->translation_vector = p_final.translation;
         // std::cout << "Printing rangeshifter specification.. : Rotation for coordinate transform
         // -->" << std::endl; p_final.rotation.dump();
@@ -1576,53 +1818,163 @@ class tps_env : public x_environment<R> {
 
         return rangeshifter;
     }
-    CUDA_HOST_DEVICE
-    bool sol1_1(mqi::vec2<float> pos, mqi::vec3<float>*& contour_points, int num_points) {
-        mqi::vec3<float> pos0 = contour_points[0];
-        mqi::vec3<float> pos1;
-        float min_y, max_y, max_x, intersect_x;
-        int count = 0;
-        int i, j, c = 0;
-        for (i = 0, j = num_points - 1; i < num_points; j = i++) {
-            pos0 = contour_points[i];
-            pos1 = contour_points[j];
-            if ((((pos0.y <= pos.y) && (pos.y < pos1.y)) ||
-                 ((pos1.y <= pos.y) && (pos.y < pos0.y))) &&
-                (pos.x < (pos1.x - pos0.x) * (pos.y - pos0.y) / (pos1.y - pos0.y) + pos0.x)) {
-                c = !c;
-            }
+    /// Returns CT slice index of a contour at z, -1 if it is outside of the CT
+    CUDA_HOST
+    int contour_slice_index(float z, mqi::vec3<ijk_t> dim, const R* z_pix) {
+        for (int i = 0; i < dim.z - 1; i++) {
+            if (z > z_pix[i] && z < z_pix[i + 1])
+                return i;
         }
-        return c;
+        return -1;
     }
-    CUDA_HOST_DEVICE
-    void fill_contour(uint8_t* volume_contour, mqi::vec3<float>*& contour_points,
-                      int num_contour_points, mqi::vec3<ijk_t> dim, const R* x_pix, const R* y_pix,
-                      const R* z_pix, float dx, float dy) {
-        int x_ind = 0, y_ind = 0, z_ind = -1;
-        for (int i = 0; i < dim.z - 1; i++) {
-            if (contour_points[0].z > z_pix[i] && contour_points[0].z < z_pix[i + 1]) {
-                z_ind = i;
-                break;
-            }
+
+    /// Converts HU to density with a table of the machine's HU to density curve.
+    /// The table covers -1000 to 6000 HU, the range hu_to_density clamps to,
+    /// and is built once since the curve doesn't change between beams.
+    /// \param hu CT values
+    /// \param rho_mass densities (g/mm^3), n values
+    CUDA_HOST
+    void convert_hu_to_density(const int16_t* hu, density_t* rho_mass, size_t n) {
+        const int16_t hu_min = -1000;
+        const int16_t hu_max = 6000;
+        if (this->hu_density.empty()) {
+            this->hu_density.resize(hu_max - hu_min + 1);
+            for (int i = hu_min; i <= hu_max; ++i)
+                this->hu_density[i - hu_min] = this->tx->material_.hu_to_density(int16_t(i));
+        }
+        const density_t* lut = this->hu_density.data();
+
+        size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+        const size_t chunk = (n + n_threads - 1) / n_threads;
+        std::vector<std::thread> workers;
+        for (size_t begin = 0; begin < n; begin += chunk) {
+            const size_t end = std::min(n, begin + chunk);
+            workers.emplace_back([=]() {
+                for (size_t i = begin; i < end; ++i) {
+                    const int16_t h = std::min(std::max(hu[i], hu_min), hu_max);
+                    rho_mass[i] = lut[h - hu_min];
+                }
+            });
         }
-        mqi::vec2<float> pos;
-        uint32_t idx = 0;
-        float x_pos, y_pos;
-        if (z_ind >= 0) {
-            for (x_ind = 0; x_ind < dim.x - 1; x_ind++) {
-                for (y_ind = 0; y_ind < dim.y - 1; y_ind++) {
-                    pos.x = x_pix[x_ind] + dx * 0.5;
-                    pos.y = y_pix[y_ind] + dy * 0.5;
-                    idx = z_ind * dim.x * dim.y + y_ind * dim.x + x_ind;
-                    assert(idx < dim.x * dim.y * dim.z);
-                    if (sol1_1(pos, contour_points, num_contour_points)) {
-                        volume_contour[idx] = 1;
+        for (auto& w : workers)
+            w.join();
+    }
+
+    /// Rasterizes contours of all slices in parallel
+    /// \param volume_contour mask of dim.x * dim.y * dim.z voxels, filled with 1 inside
+    /// \param slice_contours contours (x, y) of each slice
+    CUDA_HOST
+    void fill_contours(uint8_t* volume_contour,
+                       const std::vector<std::vector<std::vector<mqi::vec2<float>>>>& slice_contours,
+                       mqi::vec3<ijk_t> dim, const R* x_pix, const R* y_pix, float dx, float dy) {
+        const size_t nz = slice_contours.size();
+        const size_t nb_voxels_2d = dim.x * dim.y;
+        size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+        n_threads = std::max(size_t(1), std::min(n_threads, nz));
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < n_threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (size_t k = t; k < nz; k += n_threads) {
+                    if (slice_contours[k].empty())
+                        continue;
+                    mqi::fill_contour_slice(volume_contour + k * nb_voxels_2d, slice_contours[k],
+                                            dim, x_pix, y_pix, dx, dy);
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+    }
+
+    /// Creates a body mask for transport culling and fills voxels outside of the body with air
+    /// \param contour body contour, 1 inside
+    /// \param geo patient grid
+    /// \param rho_mass densities of the grid, overridden outside of the body
+    /// \return body mask with a chessboard distance map, computed in two raster passes
+    CUDA_HOST
+    mqi::body_mask_t<R>* create_body_mask(const uint8_t* contour, mqi::grid3d<density_t, R>& geo,
+                                          density_t* rho_mass) {
+        const mqi::vec3<ijk_t> dim = geo.get_nxyz();
+        const int64_t nx = dim.x, ny = dim.y, nz = dim.z;
+        const size_t nb_voxels = nx * ny * nz;
+        const density_t air = mqi::air_t<R>().rho_mass;
+
+        mqi::body_mask_t<R>* body = new mqi::body_mask_t<R>;
+        body->distance = new uint8_t[nb_voxels];
+        uint8_t* d = body->distance;
+        mqi::vec3<ijk_t> lo(dim.x, dim.y, dim.z), hi(-1, -1, -1);
+        for (int64_t k = 0; k < nz; ++k) {
+            for (int64_t j = 0; j < ny; ++j) {
+                for (int64_t i = 0; i < nx; ++i) {
+                    size_t v = (k * ny + j) * nx + i;
+                    if (contour[v]) {
+                        d[v] = 0;
+                        lo.x = std::min<ijk_t>(lo.x, i);
+                        lo.y = std::min<ijk_t>(lo.y, j);
+                        lo.z = std::min<ijk_t>(lo.z, k);
+                        hi.x = std::max<ijk_t>(hi.x, i);
+                        hi.y = std::max<ijk_t>(hi.y, j);
+                        hi.z = std::max<ijk_t>(hi.z, k);
                     } else {
-                        //                        volume_contour[idx] = 0;
+                        d[v] = 255;
+                        rho_mass[v] = air;
                     }
                 }
             }
         }
+        if (hi.x < 0) {
+            std::cout << "Body contour is empty. Transport outside of the body is not culled."
+                      << std::endl;
+            delete body;
+            return nullptr;
+        }
+
+        ///< voxels out of the grid count as obstacles, so a skip never leaves the grid
+        auto at = [&](int64_t i, int64_t j, int64_t k) -> int {
+            if (i < 0 || j < 0 || k < 0 || i >= nx || j >= ny || k >= nz)
+                return 0;
+            return d[(k * ny + j) * nx + i];
+        };
+        auto relax = [&](int64_t i, int64_t j, int64_t k, int sign) {
+            size_t v = (k * ny + j) * nx + i;
+            int m = d[v];
+            if (m == 0)
+                return;
+            ///< the 13 neighbours visited before (i, j, k) in raster order (sign 1) or after (-1)
+            for (int dk = -1; dk <= 0; ++dk) {
+                for (int dj = -1; dj <= 1; ++dj) {
+                    for (int di = -1; di <= 1; ++di) {
+                        if (dk == 0 && (dj > 0 || (dj == 0 && di >= 0)))
+                            continue;
+                        m = std::min(m, at(i + sign * di, j + sign * dj, k + sign * dk) + 1);
+                    }
+                }
+            }
+            d[v] = m;
+        };
+        for (int64_t k = 0; k < nz; ++k)
+            for (int64_t j = 0; j < ny; ++j)
+                for (int64_t i = 0; i < nx; ++i)
+                    relax(i, j, k, 1);
+        for (int64_t k = nz - 1; k >= 0; --k)
+            for (int64_t j = ny - 1; j >= 0; --j)
+                for (int64_t i = nx - 1; i >= 0; --i)
+                    relax(i, j, k, -1);
+
+        const R* xe = geo.get_x_edges();
+        const R* ye = geo.get_y_edges();
+        const R* ze = geo.get_z_edges();
+        body->lower = mqi::vec3<R>(xe[lo.x], ye[lo.y], ze[lo.z]);
+        body->upper = mqi::vec3<R>(xe[hi.x + 1], ye[hi.y + 1], ze[hi.z + 1]);
+        R h = mqi::p_inf;
+        for (int64_t i = 0; i < nx; ++i)
+            h = std::min(h, mqi::mqi_abs(xe[i + 1] - xe[i]));
+        for (int64_t j = 0; j < ny; ++j)
+            h = std::min(h, mqi::mqi_abs(ye[j + 1] - ye[j]));
+        for (int64_t k = 0; k < nz; ++k)
+            h = std::min(h, mqi::mqi_abs(ze[k + 1] - ze[k]));
+        body->min_spacing = h;
+        return body;
     }
 
     double* reshape_data(int c_ind, int s_ind, mqi::vec3<ijk_t> dim) {
@@ -1690,7 +2042,13 @@ class tps_env : public x_environment<R> {
                            this->world->children[c_ind]->scorers[s_ind]->name_;
                 dim = this->world->children[c_ind]->geo->get_nxyz();
                 vol_size = dim.x * dim.y * dim.z;
-                reshaped_data = this->reshape_data(c_ind, s_ind, dim);
+                ///< dense scorers are already laid out by cnb
+                double* dense_data = this->world->children[c_ind]->scorers[s_ind]->dense_data_;
+                if (dense_data) {
+                    reshaped_data = dense_data;
+                } else {
+                    reshaped_data = this->reshape_data(c_ind, s_ind, dim);
+                }
                 if (!this->output_format.compare("mhd")) {
                     mqi::io::save_to_mhd<R>(this->world->children[c_ind], reshaped_data,
                                             this->particles_per_history, this->output_path,
@@ -1708,7 +2066,8 @@ class tps_env : public x_environment<R> {
                                                  this->output_path, filename, vol_size);
                 }
 
-                delete[] reshaped_data;
+                if (!dense_data)
+                    delete[] reshaped_data;
             }
         }
     }
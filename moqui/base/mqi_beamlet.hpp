@@ -69,14 +69,80 @@ class beamlet {
     //    CUDA_HOST_DEVICE
     virtual mqi::vertex_t<T> operator()(std::default_random_engine* rng) {
         std::array<T, 6> phsp = (*fluence)(rng);
+        T ke = (*energy)(rng)[0];
+        return this->to_vertex(phsp, ke);
+    };
+
+#if !defined(__CUDACC__)
+    ///< Samples a primary with a transport worker's generator.
+    ///< Distributions are only read, so workers can share a beamlet.
+    virtual mqi::vertex_t<T> operator()(mqi::mqi_rng* rng) const {
+        std::array<T, 6> phsp = (*fluence)(rng);
+        T ke = (*energy)(rng)[0];
+        return this->to_vertex(phsp, ke);
+    };
+
+    ///< True if transport workers can sample both distributions
+    bool samples_on_workers() const {
+        return energy && fluence && energy->samples_on_workers() && fluence->samples_on_workers();
+    }
+#endif
+
+    /// Samples n primaries at once as columns (structure of arrays):
+    /// out[0] energy, out[1..3] position and out[4..6] direction in the patient coordinate.
+    /// Positions and directions are rotated in separate loops to keep them vectorizable.
+    CUDA_HOST
+    void sample(size_t n, std::default_random_engine* rng, std::array<T*, 7> out) const {
+        energy->sample(n, rng, {out[0]});
+        fluence->sample(n, rng, {out[1], out[2], out[3], out[4], out[5], out[6]});
+        const mqi::mat3x3<T> r = p_coord.rotation;
+        const mqi::vec3<T> t = p_coord.translation;
+        T* px = out[1];
+        T* py = out[2];
+        T* pz = out[3];
+        T* dx = out[4];
+        T* dy = out[5];
+        T* dz = out[6];
+        for (size_t i = 0; i < n; ++i) {
+            const T x = px[i], y = py[i], z = pz[i];
+            px[i] = r.xx * x + r.xy * y + r.xz * z + t.x;
+            py[i] = r.yx * x + r.yy * y + r.yz * z + t.y;
+            pz[i] = r.zx * x + r.zy * y + r.zz * z + t.z;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const T u = dx[i], v = dy[i], w = dz[i];
+            dx[i] = r.xx * u + r.xy * v + r.xz * w;
+            dy[i] = r.yx * u + r.yy * v + r.yz * w;
+            dz[i] = r.zx * u + r.zy * v + r.zz * w;
+        }
+    }
+
+    /// Samples n primaries into vertices through the columns of scratch (at least 7n values)
+    CUDA_HOST
+    void sample(size_t n, std::default_random_engine* rng, mqi::vertex_t<T>* vtx,
+                T* scratch) const {
+        std::array<T*, 7> c;
+        for (size_t j = 0; j < 7; ++j)
+            c[j] = scratch + j * n;
+        this->sample(n, rng, c);
+        for (size_t i = 0; i < n; ++i) {
+            vtx[i].ke = c[0][i];
+            vtx[i].pos = mqi::vec3<T>(c[1][i], c[2][i], c[3][i]);
+            vtx[i].dir = mqi::vec3<T>(c[4][i], c[5][i], c[6][i]);
+        }
+    }
+
+    ///< Vertex in the patient coordinate from phase-space variables in the beam coordinate
+    CUDA_HOST_DEVICE
+    mqi::vertex_t<T> to_vertex(const std::array<T, 6>& phsp, T ke) const {
         mqi::vec3<T> pos(phsp[0], phsp[1], phsp[2]);
         mqi::vec3<T> dir(phsp[3], phsp[4], phsp[5]);
         mqi::vertex_t<T> vtx;
-        vtx.ke = (*energy)(rng)[0];
+        vtx.ke = ke;
         vtx.pos = p_coord.rotation * pos + p_coord.translation;
         vtx.dir = p_coord.rotation * dir;
         return vtx;
-    };
+    }
 };
 
 }  // namespace mqi
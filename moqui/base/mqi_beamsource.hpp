@@ -4,11 +4,40 @@
 /// \file
 ///
 /// A beamsource is a collection of beamlets and provides an interface for sampling.
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <moqui/base/distributions/mqi_phsp6d_ray.hpp>
 #include <moqui/base/mqi_beamlet.hpp>
+#include <stdexcept>
 
 namespace mqi {
 
+/// \struct beamlet_arena
+/// Distributions of beamlets stored by value, one contiguous array per kind in spot order.
+/// Beamlets point into the arrays, so the capacity is reserved once and never exceeded.
+template <typename T>
+struct beamlet_arena {
+    std::vector<mqi::norm_1d<T>> energy;
+    std::vector<mqi::phsp_6d_ray<T>> fluence;
+
+    /// Reserve room for n beamlets
+    explicit beamlet_arena(size_t n) {
+        energy.reserve(n);
+        fluence.reserve(n);
+    }
+
+    /// Store distributions of a beamlet
+    /// \return a beamlet sampling the stored distributions
+    mqi::beamlet<T> emplace(mqi::norm_1d<T>&& e, mqi::phsp_6d_ray<T>&& f) {
+        if (energy.size() == energy.capacity() || fluence.size() == fluence.capacity())
+            throw std::runtime_error("Beamlet arena is full.");
+        energy.push_back(std::move(e));
+        fluence.push_back(std::move(f));
+        return mqi::beamlet<T>(&energy.back(), &fluence.back());
+    }
+};
+
 /// \class beamsource
 ///
 /// \tparam T for types for return values by the distributions
@@ -20,13 +49,19 @@ class beamsource {
     /// Each element is a tuple of beamlet, number of histories, and accumlated histories
     std::vector<std::tuple<mqi::beamlet<T>, size_t, size_t>> beamlets_;
 
-    /// A lookup table to map a history to beamlet id.
-    /// note: To run GPU, this std::map needs to be replaced GPU compatible data structure.
-    std::map<size_t, size_t> cdf2beamlet_;
-    size_t* array_cdf_;
-    size_t* array_beamlet_;
-    size_t beamlet_size_;
+    /// A flat lookup table to map a history to beamlet id (structure of arrays).
+    /// cdf_ is the strictly ascending accumulated histories and cdf_beamlet_ the beamlet id
+    /// that reaches it first, so a beamlet without histories is never selected.
+    std::vector<size_t> cdf_;
+    std::vector<size_t> cdf_beamlet_;
+    /// Device copy of cdf_ and cdf_beamlet_, set by mc::upload_beamsource
+    size_t* array_cdf_ = nullptr;
+    size_t* array_beamlet_ = nullptr;
+    size_t beamlet_size_ = 0;
     mqi::beamlet<T>* array_beamlets;
+    /// Storage of the beamlet distributions when the machine keeps them by value.
+    /// Copies of the source share it and the last one frees it.
+    std::shared_ptr<mqi::beamlet_arena<T>> arena_;
     /// A lookup table to map a time to beamlet id.
     // time,  beamlet_id
     // beamlet_id is -1 for no beam pulse
@@ -36,7 +71,33 @@ class beamsource {
     beamsource() {
         beamlets_.clear();
         timeline_.clear();
-        cdf2beamlet_.clear();
+        cdf_.clear();
+        cdf_beamlet_.clear();
+    }
+
+    /// Index of the first element of an ascending array greater than h (upper bound).
+    /// The search halves the range with a conditional move instead of a branch,
+    /// so every lookup takes log2(n) steps without mispredictions.
+    /// \return n if no element is greater than h
+    CUDA_HOST_DEVICE
+    static size_t upper_index(const size_t* cdf, size_t n, size_t h) {
+        if (n == 0)
+            return 0;
+        const size_t* base = cdf;
+        while (n > 1) {
+            const size_t half = n / 2;
+            base = (base[half - 1] <= h) ? base + half : base;
+            n -= half;
+        }
+        return (base - cdf) + (*base <= h);
+    }
+
+    /// Add an entry to the history lookup table, keeping the first beamlet of equal ones
+    void append_cdf(size_t acc, size_t beamlet_id) {
+        if (!cdf_.empty() && cdf_.back() == acc)
+            return;
+        cdf_.push_back(acc);
+        cdf_beamlet_.push_back(beamlet_id);
     }
 
     /// Add a beamlet to internal containers
@@ -58,7 +119,7 @@ class beamsource {
         const size_t acc = total_histories() + h;
         const size_t beamlet_id =
             this->total_beamlets();  // current number of beamlets -> beamlet ID
-        cdf2beamlet_.insert(std::make_pair(acc, beamlet_id));
+        this->append_cdf(acc, beamlet_id);
         beamlets_.push_back(std::make_tuple(b, h, acc));
 
         T acc_time = this->total_delivery_time() + logfileTime;
@@ -72,7 +133,7 @@ class beamsource {
         const size_t acc = total_histories() + h;
         const size_t beamlet_id =
             this->total_beamlets();  // current number of beamlets -> beamlet ID
-        cdf2beamlet_.insert(std::make_pair(acc, beamlet_id));
+        this->append_cdf(acc, beamlet_id);
         beamlets_.push_back(std::make_tuple(b, h, acc));
 
         T acc_time = this->total_delivery_time() + time_on;
@@ -109,9 +170,43 @@ class beamsource {
 
     /// Returns a beamlet of a history
     /// \return a beamlet reference (const)
-    const mqi::beamlet<T>& operator()(size_t h) {
-        size_t beamlet_id = cdf2beamlet_.upper_bound(h)->second;
-        return std::get<0>(beamlets_[beamlet_id]);
+    const mqi::beamlet<T>& operator()(size_t h) const { return this->beamlet_of(h); }
+
+    ///< Beamlet of a history, read-only so that transport workers can share the source.
+    const mqi::beamlet<T>& beamlet_of(size_t h) const {
+        const size_t i = upper_index(cdf_.data(), cdf_.size(), h);
+        return std::get<0>(beamlets_[cdf_beamlet_[i]]);
+    }
+
+#if !defined(__CUDACC__)
+    ///< True if transport workers can sample every beamlet that has histories
+    bool samples_on_workers() const {
+        for (auto& b : beamlets_) {
+            if (std::get<1>(b) > 0 && !std::get<0>(b).samples_on_workers())
+                return false;
+        }
+        return true;
+    }
+#endif
+
+    /// Samples primaries of histories [h0, h0 + n) into vertices.
+    /// Consecutive histories of a beamlet are sampled as one batch.
+    void sample(size_t h0, size_t n, std::default_random_engine* rng,
+                mqi::vertex_t<T>* out) const {
+        std::vector<T> scratch;
+        const size_t h_end = h0 + n;
+        size_t h = h0;
+        while (h < h_end) {
+            const size_t i = upper_index(cdf_.data(), cdf_.size(), h);
+            if (i == cdf_.size())
+                throw std::runtime_error("History is out of the beam source.");
+            const size_t m = std::min(h_end, cdf_[i]) - h;
+            if (scratch.size() < 7 * m)
+                scratch.resize(7 * m);
+            std::get<0>(beamlets_[cdf_beamlet_[i]]).sample(m, rng, out + (h - h0),
+                                                           scratch.data());
+            h += m;
+        }
     }
 
     /// Calculate number of accumulated histories up to given time
@@ -0,0 +1,68 @@
+#ifndef MQI_CONTOUR_HPP
+#define MQI_CONTOUR_HPP
+
+/// \file
+///
+/// Rasterization of RT structure contours into a voxel mask
+
+#include <algorithm>
+#include <moqui/base/mqi_common.hpp>
+#include <moqui/base/mqi_vec.hpp>
+#include <vector>
+
+namespace mqi {
+
+/// Rasterizes the contours of a slice with even-odd rule, so overlapping contours
+/// (e.g., holes) are XOR-ed. A voxel is inside when its center is.
+/// Crossings of every row are taken from an edge table built once per slice.
+/// \param slice_contour mask of dim.x * dim.y voxels, 1 is written inside
+/// \param contours contours (x, y) of the slice
+/// \param x_pix,y_pix lower voxel edges along x and y
+template <typename R>
+CUDA_HOST void fill_contour_slice(uint8_t* slice_contour,
+                                  const std::vector<std::vector<mqi::vec2<float>>>& contours,
+                                  mqi::vec3<ijk_t> dim, const R* x_pix, const R* y_pix, float dx,
+                                  float dy) {
+    ///< pixel centers
+    std::vector<float> xc(dim.x), yc(dim.y);
+    for (int i = 0; i < dim.x; i++)
+        xc[i] = x_pix[i] + dx * 0.5;
+    for (int j = 0; j < dim.y; j++)
+        yc[j] = y_pix[j] + dy * 0.5;
+
+    ///< edge table: x of crossings bucketed by row.
+    ///< An edge crosses row y when y is in [min(y0, y1), max(y0, y1)).
+    std::vector<std::vector<float>> crossings(dim.y);
+    for (auto& contour : contours) {
+        const int n = contour.size();
+        for (int i = 0, k = n - 1; i < n; k = i++) {
+            const mqi::vec2<float>& p0 = contour[i];
+            const mqi::vec2<float>& p1 = contour[k];
+            if (p0.y == p1.y)
+                continue;
+            const float y_lo = std::min(p0.y, p1.y);
+            const float y_hi = std::max(p0.y, p1.y);
+            int j = std::lower_bound(yc.begin(), yc.end(), y_lo) - yc.begin();
+            for (; j < dim.y && yc[j] < y_hi; j++) {
+                crossings[j].push_back((p1.x - p0.x) * (yc[j] - p0.y) / (p1.y - p0.y) + p0.x);
+            }
+        }
+    }
+
+    ///< fill spans [x_2k, x_2k+1) of each row
+    for (int j = 0; j < dim.y; j++) {
+        std::vector<float>& cx = crossings[j];
+        std::sort(cx.begin(), cx.end());
+        uint8_t* row = slice_contour + j * dim.x;
+        for (size_t k = 0; k + 1 < cx.size(); k += 2) {
+            int i0 = std::lower_bound(xc.begin(), xc.end(), cx[k]) - xc.begin();
+            int i1 = std::lower_bound(xc.begin(), xc.end(), cx[k + 1]) - xc.begin();
+            for (int i = i0; i < i1; i++)
+                row[i] = 1;
+        }
+    }
+}
+
+}  // namespace mqi
+
+#endif
@@ -6,14 +6,17 @@
 /// A 3D image grid with int16 as a pixel.
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <moqui/base/mqi_dicom_index.hpp>
 #include <moqui/base/mqi_matrix.hpp>
 #include <moqui/base/mqi_rect3d.hpp>
 
-#include "gdcmAttribute.h"
-#include "gdcmDirectory.h"
-#include "gdcmIPPSorter.h"
 #include "gdcmImageReader.h"
-#include "gdcmScanner.h"
 
 namespace mqi {
 
@@ -44,37 +47,27 @@ class ct : public rect3d<int16_t, R> {
     /// \note this method sets only dimensions and extensions.
     /// \see load_data() to read in pixel data
     CUDA_HOST
-    ct(std::string f, bool is_print = false) {
-        ct_dir = new char[f.length() + 1];
-        strcpy(ct_dir, f.c_str());
-        // http://gdcm.sourceforge.net/html/SortImage_8cxx-example.html#_a5
-        gdcm::Directory dir;
-        dir.Load(this->ct_dir, false);  ///< non-recursive
-
-        const gdcm::Directory::FilenamesType& all_files = dir.GetFilenames();
-
-        gdcm::Scanner scanner;
-        const gdcm::Tag ct_tag = gdcm::Tag(0x08, 0x60);
-        scanner.AddTag(ct_tag);
-        scanner.Scan(all_files);
-
-        auto ct_files = scanner.GetAllFilenamesFromTagToValue(ct_tag, "CT");
-
-        gdcm::IPPSorter ippsorter;
-        ippsorter.SetComputeZSpacing(false);
-        ippsorter.Sort(ct_files);  ///< asending along z
-        files_ = ippsorter.GetFilenames();
-
-        gdcm::Scanner s;
-        s.AddTag(gdcm::Tag(0x0008, 0x0018));  ///< SOP instance UID
-        s.AddTag(gdcm::Tag(0x0020, 0x0032));  ///< Image Position (Patient)
-        s.AddTag(gdcm::Tag(0x0028, 0x0010));  ///< Rows
-        s.AddTag(gdcm::Tag(0x0028, 0x0011));  ///< Columns
-        s.AddTag(gdcm::Tag(0x0028, 0x0030));  ///< Pixel spacing
-        s.AddTag(gdcm::Tag(0x0018, 0x0050));  ///< Slice thickness
-
-        if (!s.Scan(files_))
-            assert("scan fail.");
+    ct(std::string f, bool is_print = false) : ct(mqi::dicom_index(f), is_print) { ; }
+
+    /// Constructs a rectlinear grid from a DICOM directory catalogue
+    /// \param index catalogue of the CT directory
+    /// \param is_print set true if you want to print out files
+    /// \note this method sets only dimensions and extensions.
+    /// \see load_data() to read in pixel data
+    CUDA_HOST
+    ct(const mqi::dicom_index& index, bool is_print = false) {
+        ct_dir = new char[index.directory().length() + 1];
+        strcpy(ct_dir, index.directory().c_str());
+
+        ///< CT images in ascending order along z
+        std::vector<mqi::dicom_entry> images = index.sorted_images("CT");
+        if (images.empty())
+            throw std::runtime_error("No CT images in " + index.directory());
+        for (auto& img : images) {
+            files_.push_back(img.file);
+            if (is_print)
+                std::cout << img.file << std::endl;
+        }
 
         size_t nx;                  ///< columns
         size_t ny;                  ///< rows
@@ -84,40 +77,33 @@ class ct : public rect3d<int16_t, R> {
         rect3d<int16_t, R>::dim_.z = nz;
         double x0, y0;
         dz_ = new R[nz];
-        float dz;
         for (size_t i = 0; i < nz; ++i) {
-            gdcm::Scanner::TagToValue const& m0 = s.GetMapping(files_[i].c_str());
-
-            std::string img_position(m0.find(gdcm::Tag(0x0020, 0x0032))->second);
-            unsigned int deli0 = img_position.find_first_of('\\');
-            unsigned int deli1 = img_position.find_last_of('\\');
-            rect3d<int16_t, R>::z_[i] = (R)(std::stod(img_position.substr(deli1 + 1)));
-            dz_[i] = std::stod(m0.find(gdcm::Tag(0x0018, 0x0050))->second);
+            const mqi::dicom_entry& m0 = images[i];
+            rect3d<int16_t, R>::z_[i] = (R)(m0.position[2]);
+            dz_[i] = m0.slice_thickness;
 
             ///< We only determine rows, colums, x0, y0, dx, and dy with first image
             if (i == 0) {
-                x0 = std::stod(img_position.substr(0, deli0));
-                y0 = std::stod(img_position.substr(deli0 + 1, deli1 - deli0));
+                x0 = m0.position[0];
+                y0 = m0.position[1];
 
-                ny = std::stoi(m0.find(gdcm::Tag(0x0028, 0x0010))->second);
-                nx = std::stoi(m0.find(gdcm::Tag(0x0028, 0x0011))->second);
+                ny = m0.rows;
+                nx = m0.columns;
                 rect3d<int16_t, R>::dim_.x = nx;
                 rect3d<int16_t, R>::dim_.y = ny;
-                std::string pixel_spacing(m0.find(gdcm::Tag(0x0028, 0x0030))->second);
-                unsigned int deli = pixel_spacing.find_first_of('\\');
-                dx_ = std::stod(pixel_spacing.substr(0, deli));
-                dy_ = std::stod(pixel_spacing.substr(deli + 1));
+                dx_ = m0.spacing[0];
+                dy_ = m0.spacing[1];
             }
 
             ///< A map to search file path upon instance UID
-            uid2file_.insert(std::make_pair(m0.find(gdcm::Tag(0x0008, 0x0018))->second, files_[i]));
+            uid2file_.insert(std::make_pair(m0.sop_uid, files_[i]));
         }
 
         rect3d<int16_t, R>::x_ = new R[nx];
         for (size_t i = 0; i < nx; ++i) {
             rect3d<int16_t, R>::x_[i] = x0 + dx_ * i;
         }
-        rect3d<int16_t, R>::y_ = new R[nx];
+        rect3d<int16_t, R>::y_ = new R[ny];
         for (size_t i = 0; i < ny; ++i) {
             rect3d<int16_t, R>::y_[i] = y0 + dy_ * i;
         }
@@ -134,42 +120,72 @@ class ct : public rect3d<int16_t, R> {
     }
 
     /// Load patient's image to volume
+    /// \note slices are decoded concurrently, each directly into its offset in data_,
+    /// and rescaled in place with its own slope and intercept.
     CUDA_HOST
     virtual void load_data() {
         std::cout << "Reading DICOM directory.. : Loading patient CT pixel data.." << std::endl;
-        size_t nb_voxels_2d = rect3d<int16_t, R>::dim_.x * rect3d<int16_t, R>::dim_.y;
-        size_t nb_voxels_3d = nb_voxels_2d * rect3d<int16_t, R>::dim_.z;
+        const size_t nb_voxels_2d = rect3d<int16_t, R>::dim_.x * rect3d<int16_t, R>::dim_.y;
+        const size_t nz = rect3d<int16_t, R>::dim_.z;
+        const size_t nb_voxels_3d = nb_voxels_2d * nz;
 
         rect3d<int16_t, R>::data_.resize(nb_voxels_3d);
-        float intercept = 0;
-        float slope = 1;
-
-        for (size_t i = 0; i < rect3d<int16_t, R>::dim_.z; ++i) {
-            gdcm::ImageReader reader;
-            reader.SetFileName(files_[i].c_str());
-            reader.Read();
-            const gdcm::Image& img = reader.GetImage();
-
-            // n_x * n_y * bytes = img.GetBufferLength()
-            intercept = float(img.GetIntercept());
-            slope = float(img.GetSlope());
-
-            gdcm::PixelFormat pixeltype = img.GetPixelFormat();
-
-            switch (pixeltype) {
-                case gdcm::PixelFormat::INT16: {
-                    img.GetBuffer((char*)&rect3d<int16_t, R>::data_[i * nb_voxels_2d]);
-                } break;
-                default:
-                    assert(0);
-            }  // switch
-
-        }  // for
-        rect3d<int16_t, R>::data_ = rect3d<int16_t, R>::data_ * int16_t(slope) + intercept;
+        int16_t* data = &rect3d<int16_t, R>::data_[0];
+
+        std::vector<std::exception_ptr> errors(nz);
+        size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+        n_threads = std::min(n_threads, nz);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < n_threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (size_t i = t; i < nz; i += n_threads) {
+                    try {
+                        this->load_slice(files_[i], data + i * nb_voxels_2d, nb_voxels_2d);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        for (auto& e : errors) {
+            if (e)
+                std::rethrow_exception(e);
+        }
         std::cout << "Reading DICOM directory.. : Patient CT pixel data successfully loaded."
                   << std::endl;
     }
 
+    /// Decode one CT image into dst and apply its rescale slope and intercept
+    /// \param file DICOM CT image
+    /// \param dst destination of nb_pixels int16 values
+    /// \param nb_pixels number of pixels of an image (rows x columns)
+    CUDA_HOST
+    void load_slice(const std::string& file, int16_t* dst, size_t nb_pixels) const {
+        gdcm::ImageReader reader;
+        reader.SetFileName(file.c_str());
+        if (!reader.Read())
+            throw std::runtime_error("Can't read CT image: " + file);
+        const gdcm::Image& img = reader.GetImage();
+
+        if (img.GetPixelFormat() != gdcm::PixelFormat::INT16)
+            throw std::runtime_error("CT pixel format is not INT16: " + file);
+        // n_x * n_y * bytes = img.GetBufferLength()
+        if (img.GetBufferLength() != nb_pixels * sizeof(int16_t))
+            throw std::runtime_error("CT image size mismatch: " + file);
+        img.GetBuffer(reinterpret_cast<char*>(dst));
+
+        ///< same integer arithmetic as valarray<int16_t> * int16_t(slope) + intercept
+        const int16_t slope = int16_t(float(img.GetSlope()));
+        const int16_t intercept = int16_t(float(img.GetIntercept()));
+        if (slope == 1 && intercept == 0)
+            return;
+        for (size_t j = 0; j < nb_pixels; ++j) {
+            dst[j] = int16_t(dst[j] * slope + intercept);
+        }
+    }
+
     /// Returns x-index for given x position
     inline virtual size_t find_c000_x_index(const R& x) {
         assert((x >= rect3d<int16_t, R>::x_[0]) &&
@@ -0,0 +1,228 @@
+#ifndef MQI_DICOM_INDEX_HPP
+#define MQI_DICOM_INDEX_HPP
+
+/// \file
+///
+/// One pass catalogue of a DICOM directory
+///
+/// Each file's header is read once, only up to the last tag of interest,
+/// so pixel data is never touched. tps_env and ct<R> both consume the catalogue
+/// instead of scanning the same files again.
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gdcmReader.h"
+#include "gdcmStringFilter.h"
+#include "gdcmTag.h"
+
+namespace mqi {
+
+/// \struct dicom_entry
+/// Header values of a DICOM file used by moqui
+struct dicom_entry {
+    std::string file;                           ///< path of the file
+    std::string modality;                       ///< (0008,0060), e.g., CT, RTPLAN, RTSTRUCT
+    std::string sop_uid;                        ///< (0008,0018) SOP instance UID
+    bool has_position = false;                  ///< true if IPP is present
+    std::array<double, 3> position = {0, 0, 0};  ///< (0020,0032) image position (patient)
+    std::array<double, 6> orientation = {1, 0, 0, 0, 1, 0};  ///< (0020,0037) direction cosines
+    std::array<double, 2> spacing = {0, 0};  ///< (0028,0030) pixel spacing (row, column)
+    double slice_thickness = 0;               ///< (0018,0050)
+    uint16_t rows = 0;                        ///< (0028,0010)
+    uint16_t columns = 0;                     ///< (0028,0011)
+};
+
+/// \class dicom_index
+/// Catalogue of the DICOM files in a directory (non-recursive)
+class dicom_index {
+   protected:
+    std::string dir_;                    ///< indexed directory
+    std::vector<dicom_entry> entries_;   ///< readable DICOM files, in file name order
+
+   public:
+    static inline const gdcm::Tag modality_tag = gdcm::Tag(0x0008, 0x0060);
+    static inline const gdcm::Tag sop_uid_tag = gdcm::Tag(0x0008, 0x0018);
+    static inline const gdcm::Tag slice_thickness_tag = gdcm::Tag(0x0018, 0x0050);
+    static inline const gdcm::Tag position_tag = gdcm::Tag(0x0020, 0x0032);
+    static inline const gdcm::Tag orientation_tag = gdcm::Tag(0x0020, 0x0037);
+    static inline const gdcm::Tag rows_tag = gdcm::Tag(0x0028, 0x0010);
+    static inline const gdcm::Tag columns_tag = gdcm::Tag(0x0028, 0x0011);
+    static inline const gdcm::Tag spacing_tag = gdcm::Tag(0x0028, 0x0030);
+
+    dicom_index() { ; }
+
+    /// Index all regular files of a directory. Files that are not DICOM are skipped.
+    /// \param dir DICOM directory
+    dicom_index(const std::string& dir) : dir_(dir) {
+        if (!std::filesystem::is_directory(dir))
+            throw std::runtime_error("Invalid DICOM directory: " + dir);
+
+        std::vector<std::string> files;
+        for (auto& e : std::filesystem::directory_iterator(dir)) {
+            if (e.is_regular_file())
+                files.push_back(e.path().string());
+        }
+        std::sort(files.begin(), files.end());
+
+        const size_t n_files = files.size();
+        std::vector<dicom_entry> entries(n_files);
+        std::vector<char> valid(n_files, 0);
+        std::vector<std::exception_ptr> errors(n_files);
+
+        size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+        n_threads = std::min(n_threads, n_files);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < n_threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (size_t i = t; i < n_files; i += n_threads) {
+                    try {
+                        valid[i] = read_entry(files[i], entries[i]);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        for (auto& e : errors) {
+            if (e)
+                std::rethrow_exception(e);
+        }
+
+        for (size_t i = 0; i < n_files; ++i) {
+            if (valid[i])
+                entries_.push_back(std::move(entries[i]));
+        }
+    }
+
+    /// Read header of a file up to the last tag of interest
+    /// \return false if the file is not a DICOM file
+    static bool read_entry(const std::string& file, dicom_entry& entry) {
+        static const std::set<gdcm::Tag> tags = {modality_tag, sop_uid_tag,   slice_thickness_tag,
+                                                 position_tag, orientation_tag, rows_tag,
+                                                 columns_tag,  spacing_tag};
+        gdcm::Reader reader;
+        reader.SetFileName(file.c_str());
+        if (!reader.ReadSelectedTags(tags))
+            return false;
+
+        gdcm::StringFilter sf;
+        sf.SetFile(reader.GetFile());
+        const gdcm::DataSet& ds = reader.GetFile().GetDataSet();
+        auto value = [&](const gdcm::Tag& t) -> std::string {
+            if (!ds.FindDataElement(t))
+                return "";
+            return trim(sf.ToString(t));
+        };
+
+        entry.file = file;
+        entry.modality = value(modality_tag);
+        entry.sop_uid = value(sop_uid_tag);
+
+        std::string s = value(position_tag);
+        entry.has_position = !s.empty();
+        if (entry.has_position)
+            split_numbers(s, entry.position.data(), 3, file);
+        s = value(orientation_tag);
+        if (!s.empty())
+            split_numbers(s, entry.orientation.data(), 6, file);
+        s = value(spacing_tag);
+        if (!s.empty())
+            split_numbers(s, entry.spacing.data(), 2, file);
+        s = value(slice_thickness_tag);
+        if (!s.empty())
+            entry.slice_thickness = std::stod(s);
+        s = value(rows_tag);
+        if (!s.empty())
+            entry.rows = std::stoi(s);
+        s = value(columns_tag);
+        if (!s.empty())
+            entry.columns = std::stoi(s);
+        return true;
+    }
+
+    /// Directory of this catalogue
+    const std::string& directory() const { return dir_; }
+
+    /// All readable DICOM files
+    const std::vector<dicom_entry>& entries() const { return entries_; }
+
+    /// Entries of a modality in file name order
+    std::vector<dicom_entry> entries(const std::string& modality) const {
+        std::vector<dicom_entry> ret;
+        for (auto& e : entries_) {
+            if (e.modality == modality)
+                ret.push_back(e);
+        }
+        return ret;
+    }
+
+    /// File names of a modality in file name order
+    std::vector<std::string> files(const std::string& modality) const {
+        std::vector<std::string> ret;
+        for (auto& e : entries_) {
+            if (e.modality == modality)
+                ret.push_back(e.file);
+        }
+        return ret;
+    }
+
+    /// Image entries of a modality sorted along the slice normal in ascending order,
+    /// as gdcm::IPPSorter does. Images without position are dropped.
+    std::vector<dicom_entry> sorted_images(const std::string& modality) const {
+        std::vector<dicom_entry> ret;
+        for (auto& e : entries_) {
+            if (e.modality == modality && e.has_position)
+                ret.push_back(e);
+        }
+        if (ret.empty())
+            return ret;
+        const std::array<double, 6>& o = ret[0].orientation;
+        const double n[3] = {o[1] * o[5] - o[2] * o[4], o[2] * o[3] - o[0] * o[5],
+                             o[0] * o[4] - o[1] * o[3]};
+        auto distance = [&n](const dicom_entry& e) {
+            return n[0] * e.position[0] + n[1] * e.position[1] + n[2] * e.position[2];
+        };
+        std::stable_sort(ret.begin(), ret.end(),
+                         [&](const dicom_entry& a, const dicom_entry& b) {
+                             return distance(a) < distance(b);
+                         });
+        return ret;
+    }
+
+   protected:
+    /// Remove DICOM padding (spaces and NULs) on both sides
+    static std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t\r\n");
+        if (b == std::string::npos)
+            return "";
+        size_t e = s.find_last_not_of(std::string(" \t\r\n\0", 5));
+        return s.substr(b, e - b + 1);
+    }
+
+    /// Parse backslash separated multi-value numbers
+    static void split_numbers(const std::string& s, double* dst, size_t n, const std::string& file) {
+        size_t b = 0;
+        for (size_t i = 0; i < n; ++i) {
+            size_t e = s.find('\\', b);
+            if (e == std::string::npos && i + 1 < n)
+                throw std::runtime_error("Invalid multi-value in DICOM file: " + file);
+            dst[i] = std::stod(s.substr(b, e - b));
+            b = e + 1;
+        }
+    }
+};
+
+}  // namespace mqi
+
+#endif
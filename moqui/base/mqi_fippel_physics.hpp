@@ -4,6 +4,7 @@
 #include <moqui/base/mqi_error_check.hpp>
 #include <moqui/base/mqi_p_ionization.hpp>
 #include <moqui/base/mqi_physics_list.hpp>
+#include <moqui/base/mqi_physics_table.hpp>
 #include <moqui/base/mqi_po_elastic.hpp>
 #include <moqui/base/mqi_po_inelastic.hpp>
 #include <moqui/base/mqi_pp_elastic.hpp>
@@ -26,7 +27,8 @@ class fippel_physics : public physics_list<R> {
     CUDA_HOST_DEVICE
     fippel_physics()
         : p_ion(0.1, 299.6, 0.5, mqi::cs_p_ion_table, mqi::restricted_stopping_power_table,
-                mqi::range_steps),
+                mqi::range_steps, mqi::range_steps_dR, mqi::range_steps_bins,
+                mqi::range_steps_index),
           pp_e(0.5, 300.0, 0.5, mqi::cs_pp_e_g4_table),
           po_e(0.5, 300.0, 0.5, mqi::cs_po_e_g4_table),
           po_i(0.5, 300.0, 0.5, mqi::cs_po_i_g4_table)
@@ -40,7 +42,8 @@ class fippel_physics : public physics_list<R> {
     fippel_physics(R e_cut)
         : physics_list<R>::Te_cut(e_cut),
           p_ion(0.1, 299.6, 0.5, mqi::cs_p_ion_table, mqi::restricted_stopping_power_table,
-                mqi::range_steps),
+                mqi::range_steps, mqi::range_steps_dR, mqi::range_steps_bins,
+                mqi::range_steps_index),
 
           pp_e(0.5, 300.0, 0.5, mqi::cs_pp_e_g4_table),
           po_e(0.5, 300.0, 0.5, mqi::cs_po_e_g4_table),
@@ -54,6 +57,36 @@ class fippel_physics : public physics_list<R> {
     CUDA_HOST_DEVICE
     ~fippel_physics() { ; }
 
+#if !defined(__CUDACC__)
+    ///< interleaved copy of the process tables, built once and shared by all CPU threads
+    CUDA_HOST
+    static const physics_table<R>& table() {
+        static const physics_table<R> t(0.1, 299.6, 0.5, mqi::cs_p_ion_table,
+                                        mqi::restricted_stopping_power_table, mqi::range_steps,
+                                        0.5, 300.0, 0.5, mqi::cs_pp_e_g4_table,
+                                        mqi::cs_po_e_g4_table, mqi::cs_po_i_g4_table, 600);
+        return t;
+    }
+#endif
+
+    ///< cross-sections of the four processes (scaled by density) and restricted stopping power
+    ///< at Ek. One table lookup on CPU, calls to each process on GPU.
+    CUDA_HOST_DEVICE
+    inline void lookup(const R Ek, material_t<R>& mat, physics_values<R>& v) {
+#if defined(__CUDACC__)
+        mqi::relativistic_quantities<R> rel(Ek, units.Mp);
+        v.cs[0] = p_ion.cross_section(rel, mat);
+        v.cs[1] = pp_e.cross_section(rel, mat);
+        v.cs[2] = po_e.cross_section(rel, mat);
+        v.cs[3] = po_i.cross_section(rel, mat);
+        v.pw = -p_ion.dEdx(rel, mat);
+#else
+        table().lookup(Ek, v);
+        for (int k = 0; k < 4; ++k)
+            v.cs[k] *= mat.rho_mass;
+#endif
+    }
+
     ///< step length
     CUDA_HOST_DEVICE
     virtual void stepping(track_t<R>& trk, track_stack_t<R>& stk, mqi_rng* rng, const R& rho_mass,
@@ -73,20 +106,21 @@ class fippel_physics : public physics_list<R> {
         mqi::relativistic_quantities<R> rel(trk.vtx0.ke, units.Mp);
         R length = 0.0;
         /// calculate maximum possible energy-loss
-        R max_loss_step = max_energy_loss * -1.0 * rel.Ek / p_ion.dEdx(rel, mat);
+        ///< values at the pre-step energy and at the maximum energy loss
+        physics_values<R> v1, v2;
+        this->lookup(rel.Ek, mat, v1);
+        const R spr = mat.stopping_power_ratio(rel.Ek);
+        R max_loss_step = max_energy_loss * rel.Ek / v1.pw;
         R current_min_step = this->max_step;
-        current_min_step = current_min_step * mat.stopping_power_ratio(rel.Ek) * mat.rho_mass /
-                           this->units.water_density;
+        current_min_step = current_min_step * spr * mat.rho_mass / this->units.water_density;
         // current_min_step   = current_min_step * 1 * mat.rho_mass / this->units.water_density;
         current_min_step = (current_min_step <= max_loss_step) ? current_min_step : max_loss_step;
-        R max_loss_energy = -1.0 * current_min_step * p_ion.dEdx(rel, mat);
-        R cs1[4] = {p_ion.cross_section(rel, mat), pp_e.cross_section(rel, mat),
-                    po_e.cross_section(rel, mat), po_i.cross_section(rel, mat)};
+        R max_loss_energy = current_min_step * v1.pw;
+        R* cs1 = v1.cs;
         R cs1_sum = cs1[0] + cs1[1] + cs1[2] + cs1[3];
 
-        mqi::relativistic_quantities<R> rel_de(trk.vtx0.ke - max_loss_energy, units.Mp);
-        R cs2[4] = {p_ion.cross_section(rel_de, mat), pp_e.cross_section(rel_de, mat),
-                    po_e.cross_section(rel_de, mat), po_i.cross_section(rel_de, mat)};
+        this->lookup(trk.vtx0.ke - max_loss_energy, mat, v2);
+        R* cs2 = v2.cs;
         R cs2_sum = cs2[0] + cs2[1] + cs2[2] + cs2[3];
 
         ///< Pick bigger cross-section
@@ -95,8 +129,7 @@ class fippel_physics : public physics_list<R> {
 
         R prob = mqi_uniform<R>(rng);         // 0-1
         R mfp = -1.0f * logf(prob) / cs_sum;  // mm, rho_mass is g/mm^3
-        R step_limit = current_min_step * this->units.water_density /
-                       (mat.stopping_power_ratio(rel.Ek) * mat.rho_mass);
+        R step_limit = current_min_step * this->units.water_density / (spr * mat.rho_mass);
         // R step_limit = current_min_step * this->units.water_density / (1 * mat.rho_mass);
 
 #ifdef DEBUG
@@ -56,6 +56,35 @@ class grid3d {
     ///< size: dim_.x*dim_.y*dim_.z
     T* data_ = nullptr;
 
+    ///< Inverse spacing of uniformly spaced axes, 0 for other ascending axes
+    ///< and -1 for axes whose edges are not in ascending order
+    mqi::vec3<R> inv_d_;
+
+    ///< Inverse spacing if edges are uniformly spaced within geometry_tolerance, otherwise 0
+    CUDA_HOST_DEVICE
+    R uniform_inverse_spacing(const R* e, const ijk_t n) {
+        if (n < 1)
+            return 0;
+        R d = (e[n] - e[0]) / n;
+        if (d <= 0)
+            return 0;
+        for (ijk_t i = 1; i < n; ++i) {
+            if (mqi::mqi_abs(e[i] - (e[0] + i * d)) >= mqi::geometry_tolerance)
+                return 0;
+        }
+        return 1.0 / d;
+    }
+
+    ///< uniform_inverse_spacing of ascending edges, -1 otherwise
+    CUDA_HOST_DEVICE
+    R axis_inverse_spacing(const R* e, const ijk_t n) {
+        for (ijk_t i = 0; i < n; ++i) {
+            if (e[i + 1] < e[i])
+                return -1;
+        }
+        return uniform_inverse_spacing(e, n);
+    }
+
     ///< Calculate C000/C111
     CUDA_HOST_DEVICE
     void calculate_bounding_box(void) {
@@ -82,6 +111,60 @@ class grid3d {
         n100_.normalize();
         n010_.normalize();
         n001_.normalize();
+
+        inv_d_.x = axis_inverse_spacing(xe_, dim_.x);
+        inv_d_.y = axis_inverse_spacing(ye_, dim_.y);
+        inv_d_.z = axis_inverse_spacing(ze_, dim_.z);
+    }
+
+    ///< Voxel index along one axis for a point p on or near the boundary.
+    ///< Same rule as a scan over all cells taking the first match, but the scan starts
+    ///< at the first cell whose upper edge lies above p - geometry_tolerance.
+    ///< That cell is computed arithmetically for uniform axes (inv_d > 0) and
+    ///< by binary search otherwise, so the scan ends after one or two cells.
+    ///< Edges that are not ascending (inv_d < 0) are scanned from the first cell.
+    CUDA_HOST_DEVICE
+    inline ijk_t index_axis(const R* e, const ijk_t n, const R inv_d, const R p, const R dir) {
+        const R lo = p - mqi::geometry_tolerance;
+        const bool ascending = inv_d >= 0;
+        ijk_t k;  ///< first edge, k in [1, n], with e[k] > lo
+        if (!ascending) {
+            k = 1;
+        } else if (inv_d > 0) {
+            R f = (lo - e[0]) * inv_d;
+            k = (f < 0) ? 1 : (f >= n) ? n : ijk_t(f) + 1;
+            while (k > 1 && e[k - 1] > lo)
+                --k;
+            while (k < n && e[k] <= lo)
+                ++k;
+        } else {
+            ijk_t first = 1;
+            ijk_t count = n;
+            while (count > 0) {
+                ijk_t step = count / 2;
+                if (e[first + step] <= lo) {
+                    first += step + 1;
+                    count -= step + 1;
+                } else {
+                    count = step;
+                }
+            }
+            k = (first > n) ? n : first;
+        }
+        ///< one cell earlier guards against rounding of lo
+        ijk_t ind = (k >= 2) ? k - 2 : 0;
+        for (; ind < n; ++ind) {
+            if (mqi::mqi_abs(e[ind] - p) < mqi::geometry_tolerance) {
+                return (dir < 0) ? ind - 1 : ind;
+            } else if (mqi::mqi_abs(e[ind + 1] - p) < mqi::geometry_tolerance) {
+                return (dir > 0) ? ind + 1 : ind;
+            } else if (e[ind] - p < 0 && e[ind + 1] - p > 0) {
+                return ind;
+            } else if (ascending && e[ind] - p >= mqi::geometry_tolerance) {
+                break;  ///< edges only grow from here
+            }
+        }
+        return -1;
     }
 
    public:
@@ -309,6 +392,10 @@ class grid3d {
     CUDA_HOST_DEVICE
     mqi::vec3<ijk_t> get_nxyz() { return dim_; }
 
+    /// Returns true if all three axes are uniformly spaced
+    CUDA_HOST_DEVICE
+    bool is_uniform() const { return inv_d_.x > 0 && inv_d_.y > 0 && inv_d_.z > 0; }
+
     /// Returns the data value for given x/y/z index
     /// \param[in] p index, p[0], p[1], p[2] for x, y, z.
     CUDA_HOST_DEVICE
@@ -673,99 +760,9 @@ class grid3d {
     inline mqi::vec3<ijk_t> index(const mqi::vec3<R>& p, mqi::vec3<R>& dir)  // if p is on boundary
     {  // find index for the first intersection, return voxel index
         mqi::vec3<ijk_t> idx;
-        R min_x = 100.0, min_y = 100.0, min_z = 100.0;
-        for (int ind = 0; ind < dim_.x; ind++) {
-            if (mqi::mqi_abs(xe_[ind] - p.x) < mqi::geometry_tolerance) {
-                if (dir.x > 0) {
-                    idx.x = ind;
-                    break;
-                } else if (dir.x < 0) {
-                    idx.x = ind - 1;
-                    break;
-                } else {
-                    idx.x = ind;
-                    break;
-                }
-            } else if (mqi::mqi_abs(xe_[ind + 1] - p.x) < mqi::geometry_tolerance) {
-                if (dir.x > 0) {
-                    idx.x = ind + 1;
-                    break;
-                } else if (dir.x < 0) {
-                    idx.x = ind;
-                    break;
-                } else {
-                    idx.x = ind;
-                    break;
-                }
-            } else if (xe_[ind] - p.x < 0 && xe_[ind + 1] - p.x > 0) {
-                idx.x = ind;
-                break;
-            } else {
-                idx.x = -1;
-            }
-        }
-
-        for (int ind = 0; ind < dim_.y; ind++) {
-            if (mqi::mqi_abs(ye_[ind] - p.y) < mqi::geometry_tolerance) {
-                if (dir.y > 0) {
-                    idx.y = ind;
-                    break;
-                } else if (dir.y < 0) {
-                    idx.y = ind - 1;
-                    break;
-                } else {
-                    idx.y = ind;
-                    break;
-                }
-            } else if (mqi::mqi_abs(ye_[ind + 1] - p.y) < mqi::geometry_tolerance) {
-                if (dir.y > 0) {
-                    idx.y = ind + 1;
-                    break;
-                } else if (dir.y < 0) {
-                    idx.y = ind;
-                    break;
-                } else {
-                    idx.y = ind;
-                    break;
-                }
-            } else if (ye_[ind] - p.y < 0 && ye_[ind + 1] - p.y > 0) {
-                idx.y = ind;
-                break;
-            } else {
-                idx.y = -1;
-            }
-        }
-
-        for (int ind = 0; ind < dim_.z; ind++) {
-            if (mqi::mqi_abs(ze_[ind] - p.z) < mqi::geometry_tolerance) {
-                if (dir.z > 0) {
-                    idx.z = ind;
-                    break;
-                } else if (dir.z < 0) {
-                    idx.z = ind - 1;
-                    break;
-                } else {
-                    idx.z = ind;
-                    break;
-                }
-            } else if (mqi::mqi_abs(ze_[ind + 1] - p.z) < mqi::geometry_tolerance) {
-                if (dir.z > 0) {
-                    idx.z = ind + 1;
-                    break;
-                } else if (dir.z < 0) {
-                    idx.z = ind;
-                    break;
-                } else {
-                    idx.z = ind;
-                    break;
-                }
-            } else if (ze_[ind] - p.z < 0 && ze_[ind + 1] - p.z > 0) {
-                idx.z = ind;
-                break;
-            } else {
-                idx.z = -1;
-            }
-        }
+        idx.x = index_axis(xe_, dim_.x, inv_d_.x, p.x, dir.x);
+        idx.y = index_axis(ye_, dim_.y, inv_d_.y, p.y, dir.y);
+        idx.z = index_axis(ze_, dim_.z, inv_d_.z, p.z, dir.z);
         return idx;
     }
 
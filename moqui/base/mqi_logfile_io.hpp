@@ -0,0 +1,315 @@
+#ifndef MQI_LOGFILE_IO_HPP
+#define MQI_LOGFILE_IO_HPP
+
+/// \file
+///
+/// Reader and binary cache for delivery log files (one csv per energy layer)
+///
+/// A layer file is a comma separated stream of (time, x, y, MU count) records.
+/// Only ',' separates fields, exactly as std::getline(fs, str, ',') did before,
+/// and each field is parsed from its leading number like std::stof/std::stoi.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <moqui/base/mqi_beam_module_ion.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mqi {
+namespace io {
+
+///< Read-only memory map of a whole file, unmapped on destruction
+class mapped_file {
+   public:
+    const char* data = nullptr;
+    size_t size = 0;
+
+    mapped_file(const std::string& filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Can't open file: " + filename);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Can't stat file: " + filename);
+        }
+        size = st.st_size;
+        if (size > 0) {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Can't map file: " + filename);
+            }
+            data = static_cast<const char*>(p);
+        }
+        close(fd);
+    }
+
+    ~mapped_file() {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+};
+
+///< Parse the leading number of a field [first, last) as std::stof/std::stoi do:
+///< leading white spaces and a '+' sign are skipped, trailing characters are ignored.
+template <typename T>
+inline bool parse_leading_number(const char* first, const char* last, T& value) {
+    while (first < last && std::isspace(static_cast<unsigned char>(*first)))
+        ++first;
+    if (first < last && *first == '+')
+        ++first;
+    return std::from_chars(first, last, value).ec == std::errc();
+}
+
+///< Beam energy of a layer from its file name, e.g., 1_230MeV.csv or 12_70.5MeV.csv.
+///< The number right before "MeV" is used, otherwise the number after the last '_'.
+inline float log_layer_energy(const std::filesystem::path& filename) {
+    std::string stem = filename.stem().string();
+    size_t end = stem.rfind("MeV");
+    size_t begin;
+    if (end != std::string::npos) {
+        begin = end;
+        while (begin > 0 && (std::isdigit(static_cast<unsigned char>(stem[begin - 1])) ||
+                             stem[begin - 1] == '.'))
+            --begin;
+    } else {
+        size_t us = stem.rfind('_');
+        begin = (us == std::string::npos) ? 0 : us + 1;
+        end = stem.size();
+    }
+    float energy;
+    if (begin == end || !parse_leading_number(stem.data() + begin, stem.data() + end, energy))
+        throw std::runtime_error("Can't find beam energy in log file name: " + filename.string());
+    return energy;
+}
+
+///< Read a layer log file.
+///< MU counts are scaled by particles_per_history and truncated to int.
+inline logfile_t read_log_csv(const std::string& filename, float particles_per_history) {
+    logfile_t layer;
+    mapped_file f(filename);
+    const char* p = f.data;
+    const char* end = f.data + f.size;
+
+    ///< one record has 4 fields
+    size_t n_fields = std::count(p, end, ',') + 1;
+    layer.posX.reserve(n_fields / 4 + 1);
+    layer.posY.reserve(n_fields / 4 + 1);
+    layer.muCount.reserve(n_fields / 4 + 1);
+
+    int csvIndex = 0;
+    while (p < end) {
+        const char* comma = static_cast<const char*>(std::memchr(p, ',', end - p));
+        const char* field_end = comma ? comma : end;
+        csvIndex += 1;
+        bool ok = true;
+        if (csvIndex == 2) {
+            float x = 0;
+            ok = parse_leading_number(p, field_end, x);
+            layer.posX.push_back(x);
+        } else if (csvIndex == 3) {
+            float y = 0;
+            ok = parse_leading_number(p, field_end, y);
+            layer.posY.push_back(y);
+        } else if (csvIndex == 4) {
+            int mu = 0;
+            ok = parse_leading_number(p, field_end, mu);
+            layer.muCount.push_back(static_cast<int>(mu * particles_per_history));
+            csvIndex = 0;
+        }
+        if (!ok)
+            throw std::runtime_error("Invalid number in log file: " + filename);
+        if (!comma)
+            break;
+        p = comma + 1;
+    }
+    return layer;
+}
+
+///< Read all layer files of a field in parallel.
+///< layers and energies keep the order of filenames.
+inline void read_log_field(const std::vector<std::filesystem::path>& filenames,
+                           float particles_per_history, std::vector<logfile_t>& layers,
+                           std::vector<float>& energies) {
+    const size_t n_files = filenames.size();
+    layers.assign(n_files, logfile_t());
+    energies.assign(n_files, 0);
+    std::vector<std::exception_ptr> errors(n_files);
+
+    size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+    n_threads = std::min(n_threads, n_files);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < n_threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (size_t i = t; i < n_files; i += n_threads) {
+                try {
+                    energies[i] = log_layer_energy(filenames[i]);
+                    layers[i] = read_log_csv(filenames[i].string(), particles_per_history);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    for (auto& e : errors) {
+        if (e)
+            std::rethrow_exception(e);
+    }
+}
+
+///< Binary cache of the layers of a field.
+///< Layout (native endianness):
+///<   header   : char magic[8], uint64_t hash, uint32_t n_layers, uint32_t reserved
+///<   table    : n_layers x { float energy, uint32_t n_x, uint32_t n_y, uint32_t n_mu }
+///<   per layer: float posX[n_x], float posY[n_y], int32_t muCount[n_mu]
+struct log_cache_header {
+    char magic[8];
+    uint64_t hash;
+    uint32_t n_layers;
+    uint32_t reserved;
+};
+
+struct log_cache_layer {
+    float energy;
+    uint32_t n_x;
+    uint32_t n_y;
+    uint32_t n_mu;
+};
+
+static const char log_cache_magic[8] = {'M', 'Q', 'I', 'L', 'O', 'G', '0', '1'};
+
+///< FNV-1a 64-bit hash
+inline uint64_t fnv1a(const void* src, size_t n, uint64_t h = 0xcbf29ce484222325ULL) {
+    const unsigned char* c = static_cast<const unsigned char*>(src);
+    for (size_t i = 0; i < n; ++i) {
+        h ^= c[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+///< Key of the layer files of a field: names, sizes, modification times and the MU scale.
+///< Only the file metadata is read, so a file rewritten with the same size and
+///< time stamp is not detected.
+inline uint64_t hash_log_files(const std::vector<std::filesystem::path>& filenames,
+                               float particles_per_history) {
+    uint64_t h = fnv1a(&particles_per_history, sizeof(particles_per_history));
+    for (auto& filename : filenames) {
+        std::string name = filename.filename().string();
+        h = fnv1a(name.data(), name.size() + 1, h);
+        const uint64_t size = std::filesystem::file_size(filename);
+        const int64_t mtime =
+            std::filesystem::last_write_time(filename).time_since_epoch().count();
+        h = fnv1a(&size, sizeof(size), h);
+        h = fnv1a(&mtime, sizeof(mtime), h);
+    }
+    return h;
+}
+
+///< Load layers from a cache file written by write_log_cache.
+///< Returns false if the file is missing, malformed or made for another hash.
+inline bool read_log_cache(const std::string& cache_file, uint64_t hash,
+                           std::vector<logfile_t>& layers, std::vector<float>& energies) {
+    if (!std::filesystem::exists(cache_file))
+        return false;
+    mapped_file f(cache_file);
+    if (f.size < sizeof(log_cache_header))
+        return false;
+    log_cache_header header;
+    std::memcpy(&header, f.data, sizeof(header));
+    if (std::memcmp(header.magic, log_cache_magic, sizeof(log_cache_magic)) != 0 ||
+        header.hash != hash)
+        return false;
+
+    size_t offset = sizeof(header) + header.n_layers * sizeof(log_cache_layer);
+    if (f.size < offset)
+        return false;
+    std::vector<log_cache_layer> table(header.n_layers);
+    std::memcpy(table.data(), f.data + sizeof(header), header.n_layers * sizeof(log_cache_layer));
+
+    size_t total = offset;
+    for (auto& t : table)
+        total += t.n_x * sizeof(float) + t.n_y * sizeof(float) + t.n_mu * sizeof(int32_t);
+    if (f.size != total)
+        return false;
+
+    layers.assign(header.n_layers, logfile_t());
+    energies.resize(header.n_layers);
+    for (uint32_t i = 0; i < header.n_layers; ++i) {
+        energies[i] = table[i].energy;
+        const float* x = reinterpret_cast<const float*>(f.data + offset);
+        layers[i].posX.assign(x, x + table[i].n_x);
+        offset += table[i].n_x * sizeof(float);
+        const float* y = reinterpret_cast<const float*>(f.data + offset);
+        layers[i].posY.assign(y, y + table[i].n_y);
+        offset += table[i].n_y * sizeof(float);
+        const int32_t* mu = reinterpret_cast<const int32_t*>(f.data + offset);
+        layers[i].muCount.assign(mu, mu + table[i].n_mu);
+        offset += table[i].n_mu * sizeof(int32_t);
+    }
+    return true;
+}
+
+///< Write layers to a cache file. The file is written next to its final name
+///< and renamed, so a concurrent reader never sees a partial cache.
+inline bool write_log_cache(const std::string& cache_file, uint64_t hash,
+                            const std::vector<logfile_t>& layers,
+                            const std::vector<float>& energies) {
+    log_cache_header header;
+    std::memcpy(header.magic, log_cache_magic, sizeof(log_cache_magic));
+    header.hash = hash;
+    header.n_layers = layers.size();
+    header.reserved = 0;
+
+    std::vector<log_cache_layer> table(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        table[i].energy = energies[i];
+        table[i].n_x = layers[i].posX.size();
+        table[i].n_y = layers[i].posY.size();
+        table[i].n_mu = layers[i].muCount.size();
+    }
+
+    std::string tmp_file = cache_file + ".tmp";
+    std::ofstream fs(tmp_file, std::ios::binary | std::ios::trunc);
+    if (!fs)
+        return false;
+    fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fs.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(log_cache_layer));
+    for (auto& l : layers) {
+        fs.write(reinterpret_cast<const char*>(l.posX.data()), l.posX.size() * sizeof(float));
+        fs.write(reinterpret_cast<const char*>(l.posY.data()), l.posY.size() * sizeof(float));
+        fs.write(reinterpret_cast<const char*>(l.muCount.data()),
+                 l.muCount.size() * sizeof(int32_t));
+    }
+    fs.close();
+    if (!fs) {
+        std::remove(tmp_file.c_str());
+        return false;
+    }
+    return std::rename(tmp_file.c_str(), cache_file.c_str()) == 0;
+}
+
+}  // namespace io
+}  // namespace mqi
+
+#endif
@@ -380,57 +380,167 @@ bool mqi_isnan(double s) {
     return std::isnan(s);
 }
 
-// compile: ERROR
-typedef std::default_random_engine mqi_rng;
-// typedef std::mt19937 mqi_rng;
+///< Counter-based random number generator, Philox4x32-10
+///< (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC'11).
+///< The key is the master seed and the 128-bit counter is
+///< (draw block, stream, history low, history high), so each (seed, stream, history)
+///< has its own reproducible sequence regardless of which thread or batch runs it.
+///< Stream is the beam number and history is the index of a primary in the beam,
+///< which also identifies its spot. See mqi::initialize_threads and set_history().
+class philox_rng {
+   public:
+    typedef uint32_t result_type;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xffffffff; }
+
+    philox_rng(uint64_t seed = 0, uint32_t stream = 0) { set_key(seed, stream); }
+
+    ///< select seed and stream, and start history 0
+    inline void set_key(uint64_t seed, uint32_t stream) {
+        key_[0] = uint32_t(seed);
+        key_[1] = uint32_t(seed >> 32);
+        stream_ = stream;
+        set_history(0);
+    }
+
+    ///< restart the sequence of a history
+    inline void set_history(uint64_t history) {
+        ctr_[0] = 0;
+        ctr_[1] = stream_;
+        ctr_[2] = uint32_t(history);
+        ctr_[3] = uint32_t(history >> 32);
+        idx_ = 4;
+        has_spare_ = false;
+    }
+
+    inline result_type operator()() {
+        if (idx_ == 4) {
+            generate();
+            ++ctr_[0];
+            idx_ = 0;
+        }
+        return out_[idx_++];
+    }
+
+    bool has_spare_ = false;  ///< second value of the last Box-Muller pair is cached
+    double spare_ = 0;
+
+   protected:
+    uint32_t key_[2];
+    uint32_t ctr_[4];
+    uint32_t out_[4];
+    uint32_t stream_ = 0;
+    uint32_t idx_ = 4;
+
+    inline static void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+        const uint64_t p = uint64_t(a) * b;
+        hi = uint32_t(p >> 32);
+        lo = uint32_t(p);
+    }
+
+    inline void generate() {
+        uint32_t c[4] = {ctr_[0], ctr_[1], ctr_[2], ctr_[3]};
+        uint32_t k[2] = {key_[0], key_[1]};
+        for (int r = 0; r < 10; ++r) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53, c[0], hi0, lo0);
+            mulhilo(0xCD9E8D57, c[2], hi1, lo1);
+            c[0] = hi1 ^ c[1] ^ k[0];
+            c[1] = lo1;
+            c[2] = hi0 ^ c[3] ^ k[1];
+            c[3] = lo0;
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+        }
+        out_[0] = c[0];
+        out_[1] = c[1];
+        out_[2] = c[2];
+        out_[3] = c[3];
+    }
+};
+
+typedef philox_rng mqi_rng;
 
+///< uniform in (0, 1] as curand_uniform
 template <>
-float mqi_uniform<float>(mqi_rng* rng) {
-    std::uniform_real_distribution<float> dist;
-    return dist(*rng);
+inline float mqi_uniform<float>(mqi_rng* rng) {
+    return float(((*rng)() >> 8) + 1) * (1.0f / 16777216.0f);
 }
 
 template <>
-double mqi_uniform<double>(mqi_rng* rng) {
-    std::uniform_real_distribution<double> dist;
-    return dist(*rng);
+inline double mqi_uniform<double>(mqi_rng* rng) {
+    const uint64_t a = (*rng)() >> 6;
+    const uint64_t b = (*rng)() >> 5;
+    return double(((a << 27) | b) + 1) * (1.0 / 9007199254740992.0);
+}
+
+///< Box-Muller, the second value of a pair is kept for the next call
+inline double mqi_standard_normal(mqi_rng* rng) {
+    if (rng->has_spare_) {
+        rng->has_spare_ = false;
+        return rng->spare_;
+    }
+    const double r = std::sqrt(-2.0 * std::log(mqi_uniform<double>(rng)));
+    const double phi = 2.0 * M_PI * mqi_uniform<double>(rng);
+    rng->spare_ = r * std::sin(phi);
+    rng->has_spare_ = true;
+    return r * std::cos(phi);
 }
 
 template <>
-float mqi_normal<float>(mqi_rng* rng, float avg, float sig) {
-    std::normal_distribution<float> dist(avg, sig);
-    return dist(*rng);
+inline float mqi_normal<float>(mqi_rng* rng, float avg, float sig) {
+    return float(mqi_standard_normal(rng)) * sig + avg;
 }
 
 template <>
-double mqi_normal<double>(mqi_rng* rng, double avg, double sig) {
-    std::normal_distribution<double> dist(avg, sig);
-    return dist(*rng);
+inline double mqi_normal<double>(mqi_rng* rng, double avg, double sig) {
+    return mqi_standard_normal(rng) * sig + avg;
 }
 
 template <>
-float mqi_exponential<float>(mqi_rng* rng, float avg, float up) {
-    float x;
-    std::exponential_distribution<float> dist(avg);
-    x = dist(*rng);
-    //    do {
-    //        x = dist(*rng);
-    //    } while (x > up || x <= 0);
-    return x;
+inline float mqi_exponential<float>(mqi_rng* rng, float avg, float up) {
+    return -std::log(mqi_uniform<float>(rng)) / avg;
 }
 
 template <>
-double mqi_exponential<double>(mqi_rng* rng, double avg, double up) {
+inline double mqi_exponential<double>(mqi_rng* rng, double avg, double up) {
     double x;
-    std::exponential_distribution<double> dist(avg);
     do {
-        x = dist(*rng);
+        x = -std::log(mqi_uniform<double>(rng)) / avg;
     } while (x > up || x <= 0);
     return x;
 }
 
 #endif
 
+///< Fills x[0, n) with standard normals for host side batch sampling (Box-Muller).
+///< All uniforms are drawn first, so the transform is a loop over arrays
+///< that the compiler vectorizes, including log/cos when vector math is enabled.
+///< sin is written as a shifted cos, a sin/cos pair would be fused into sincos
+///< which has no vector form.
+template <typename T>
+CUDA_HOST inline void mqi_standard_normals(std::default_random_engine* rng, T* x, size_t n) {
+    ///< uniform in (0, 1)
+    const double scale = 1.0 / (double(rng->max() - rng->min()) + 1.0);
+    for (size_t i = 0; i < n; ++i)
+        x[i] = T((double((*rng)() - rng->min()) + 0.5) * scale);
+
+    ///< pairs are (x[i], x[m + i]), an odd last value takes one more uniform
+    const size_t m = n / 2;
+    T* u = x + m;
+    for (size_t i = 0; i < m; ++i) {
+        const T r = std::sqrt(T(-2) * std::log(x[i]));
+        const T phi = T(2.0 * M_PI) * u[i];
+        x[i] = r * std::cos(phi);
+        u[i] = r * std::cos(phi - T(0.5 * M_PI));
+    }
+    if (n % 2) {
+        const T phi = T(2.0 * M_PI * (double((*rng)() - rng->min()) + 0.5) * scale);
+        x[n - 1] = std::sqrt(T(-2) * std::log(x[n - 1])) * std::cos(phi);
+    }
+}
+
 }  // namespace mqi
 
 #endif
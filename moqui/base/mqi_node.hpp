@@ -13,6 +13,49 @@
 /// navigator is shared by block level or device level.
 namespace mqi {
 
+///< body_mask_t : voxels outside of a body contour, used to cull transport in air
+template <typename R>
+struct body_mask_t {
+    ///< Chebyshev distance in voxels to the nearest body voxel or grid boundary,
+    ///< 0 inside the body and capped at 255.
+    uint8_t* distance = nullptr;
+    R min_spacing = 0;    ///< smallest voxel size of the grid
+    mqi::vec3<R> lower;  ///< bounding box of the body in node coordinates
+    mqi::vec3<R> upper;
+
+    ///< true if a ray from p along d reaches the body bounding box
+    CUDA_HOST_DEVICE
+    bool is_ahead(const mqi::vec3<R>& p, const mqi::vec3<R>& d) const {
+        R t0 = 0;
+        R t1 = mqi::p_inf;
+        const R ps[3] = {p.x, p.y, p.z};
+        const R ds[3] = {d.x, d.y, d.z};
+        const R lo[3] = {lower.x, lower.y, lower.z};
+        const R hi[3] = {upper.x, upper.y, upper.z};
+        for (int i = 0; i < 3; ++i) {
+            if (ds[i] == 0) {
+                if (ps[i] < lo[i] || ps[i] > hi[i])
+                    return false;
+                continue;
+            }
+            R ta = (lo[i] - ps[i]) / ds[i];
+            R tb = (hi[i] - ps[i]) / ds[i];
+            if (ta > tb) {
+                R tmp = ta;
+                ta = tb;
+                tb = tmp;
+            }
+            t0 = (ta > t0) ? ta : t0;
+            t1 = (tb < t1) ? tb : t1;
+            if (t0 > t1)
+                return false;
+        }
+        return true;
+    }
+
+    ~body_mask_t() { delete[] distance; }
+};
+
 ///< node_t : a geometry and it's scorers
 /// T: material id
 /// R: values in x/y/z and scoreing type
@@ -33,6 +76,9 @@ struct node_t {
 
     uint16_t n_children = 0;
     struct node_t<R>** children = nullptr;
+
+    ///< optional body mask to cull transport outside of the patient (host only)
+    body_mask_t<R>* body_mask = nullptr;
 };
 
 }  // namespace mqi
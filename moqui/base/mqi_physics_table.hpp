@@ -0,0 +1,126 @@
+#ifndef MQI_PHYSICS_TABLE_HPP
+#define MQI_PHYSICS_TABLE_HPP
+
+/// \file
+///
+/// Interleaved proton physics table for the stepping loop
+///
+/// The tabulated cross-sections, restricted stopping power and range are stored
+/// row by row, four values per energy bin, so a single bin search and one pair of
+/// adjacent rows (two 16-byte aligned vectors) give every quantity at an energy.
+/// Delta ionization uses its own energy grid (0.1 MeV offset), so there are two
+/// interleaved tables, one per grid.
+
+#include <cstddef>
+#include <new>
+
+#include <moqui/base/mqi_common.hpp>
+#include <moqui/base/mqi_math.hpp>
+
+namespace mqi {
+
+///< Physics quantities at one energy.
+///< Cross-sections are per unit density, in the order of
+///< delta ionization, pp elastic, po elastic, po inelastic.
+template <typename R>
+struct physics_values {
+    R cs[4];
+    R pw;     ///< restricted stopping power (positive)
+    R range;  ///< CSDA range in water
+};
+
+template <typename R>
+class physics_table {
+   public:
+    static const int row = 4;  ///< values per bin, padded for alignment
+
+   protected:
+    ///< grid of delta ionization: cs, restricted stopping power, range, pad
+    R ion_min_, ion_max_, ion_step_, ion_inv_step_;
+    ///< grid of nuclear processes: pp elastic, po elastic, po inelastic cs, pad
+    R nuc_min_, nuc_max_, nuc_step_, nuc_inv_step_;
+    int n_;  ///< number of bins of each grid
+
+    R* ion_ = nullptr;
+    R* nuc_ = nullptr;
+
+    ///< aligned rows, one extra row repeats the last one so that idx + 1 is always valid
+    static R* allocate_rows(int n) {
+        R* p = static_cast<R*>(::operator new[](sizeof(R) * row * (n + 1), std::align_val_t(64)));
+        for (int i = 0; i < row * (n + 1); ++i)
+            p[i] = 0;
+        return p;
+    }
+
+   public:
+    CUDA_HOST
+    physics_table(R ion_min, R ion_max, R ion_step, const float* cs_ion, const float* pw,
+                  const float* range, R nuc_min, R nuc_max, R nuc_step, const float* cs_pp_e,
+                  const float* cs_po_e, const float* cs_po_i, int n)
+        : ion_min_(ion_min),
+          ion_max_(ion_max),
+          ion_step_(ion_step),
+          ion_inv_step_(1.0 / ion_step),
+          nuc_min_(nuc_min),
+          nuc_max_(nuc_max),
+          nuc_step_(nuc_step),
+          nuc_inv_step_(1.0 / nuc_step),
+          n_(n) {
+        ion_ = allocate_rows(n);
+        nuc_ = allocate_rows(n);
+        for (int i = 0; i <= n; ++i) {
+            const int j = (i < n) ? i : n - 1;
+            ion_[row * i + 0] = cs_ion[j];
+            ion_[row * i + 1] = pw[j];
+            ion_[row * i + 2] = range[j];
+            nuc_[row * i + 0] = cs_pp_e[j];
+            nuc_[row * i + 1] = cs_po_e[j];
+            nuc_[row * i + 2] = cs_po_i[j];
+        }
+    }
+
+    CUDA_HOST
+    ~physics_table() {
+        ::operator delete[](ion_, std::align_val_t(64));
+        ::operator delete[](nuc_, std::align_val_t(64));
+    }
+
+    physics_table(const physics_table&) = delete;
+    physics_table& operator=(const physics_table&) = delete;
+
+    ///< All quantities at Ek, same ranges and rules as the tabulated processes:
+    ///< zero outside of a grid, except the stopping power which keeps its first value
+    ///< below the ionization grid.
+    CUDA_HOST
+    inline void lookup(const R Ek, physics_values<R>& v) const {
+        if (Ek >= ion_min_ && Ek <= ion_max_) {
+            const int i = int((Ek - ion_min_) * ion_inv_step_);
+            const R w = (Ek - (ion_min_ + i * ion_step_)) * ion_inv_step_;
+            const R* a = ion_ + row * i;
+            const R* b = a + row;
+            v.cs[0] = a[0] + w * (b[0] - a[0]);
+            v.pw = a[1] + w * (b[1] - a[1]);
+            v.range = a[2] + w * (b[2] - a[2]);
+        } else {
+            v.cs[0] = 0;
+            v.pw = (Ek < ion_min_ && Ek > 0) ? ion_[1] : 0;
+            v.range = (Ek < ion_min_) ? ion_[2] : ion_[row * n_ + 2];
+        }
+        if (Ek >= nuc_min_ && Ek <= nuc_max_) {
+            const int i = int((Ek - nuc_min_) * nuc_inv_step_);
+            const R w = (Ek - (nuc_min_ + i * nuc_step_)) * nuc_inv_step_;
+            const R* a = nuc_ + row * i;
+            const R* b = a + row;
+            for (int k = 0; k < 3; ++k)
+                v.cs[k + 1] = a[k] + w * (b[k] - a[k]);
+        } else {
+            v.cs[1] = 0;
+            v.cs[2] = 0;
+            v.cs[3] = 0;
+        }
+    }
+};
+
+}  // namespace mqi
+
+#endif
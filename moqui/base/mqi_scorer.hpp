@@ -41,6 +41,10 @@ class scorer {
 
     ///< Memory area for scorer data
     mqi::key_value* data_ = nullptr;
+
+    ///< Dense storage mode: one value per voxel indexed by cnb, no keys.
+    ///< Used instead of data_ for voxel-keyed (PER_BEAM) scoring when set.
+    double* dense_data_ = nullptr;
     uint32_t max_capacity_ = 0;      //// Max capacity is 32-bit integer
     uint32_t current_capacity_ = 0;  //// Max capacity is 32-bit integer
 
@@ -59,6 +63,11 @@ class scorer {
 
 #else
     std::mutex mtx;
+
+    ///< Per-thread private dense accumulators indexed by cnb (CPU, PER_BEAM only)
+    ///< merged into data_ by mc::reduce_thread_data at the end of a batch
+    double** thread_data_ = nullptr;
+    uint32_t n_thread_data_ = 0;
 #endif
 
     ///< Construct with size
@@ -80,13 +89,52 @@ class scorer {
     void delete_data_if_used(void) {
         if (data_ != nullptr)
             delete[] data_;
+        if (dense_data_ != nullptr)
+            delete[] dense_data_;
         if (count_ != nullptr)
             delete[] count_;
         if (mean_ != nullptr)
             delete[] mean_;
         if (variance_ != nullptr)
             delete[] variance_;
+#if !defined(__CUDACC__)
+        this->delete_thread_data();
+#endif
     }
+
+#if !defined(__CUDACC__)
+    ///< memory of private accumulators for n_threads workers in bytes
+    CUDA_HOST
+    size_t thread_data_bytes(uint32_t n_threads) const {
+        return size_t(n_threads) * max_capacity_ * sizeof(double);
+    }
+
+    ///< allocate zeroed private accumulators for n_threads workers.
+    ///< existing buffers are kept when they already cover n_threads
+    CUDA_HOST
+    void allocate_thread_data(uint32_t n_threads) {
+        if (thread_data_ != nullptr && n_thread_data_ >= n_threads)
+            return;
+        this->delete_thread_data();
+        thread_data_ = new double*[n_threads];
+        for (uint32_t i = 0; i < n_threads; ++i) {
+            thread_data_[i] = new double[max_capacity_]();
+        }
+        n_thread_data_ = n_threads;
+    }
+
+    CUDA_HOST
+    void delete_thread_data(void) {
+        if (thread_data_ == nullptr)
+            return;
+        for (uint32_t i = 0; i < n_thread_data_; ++i) {
+            delete[] thread_data_[i];
+        }
+        delete[] thread_data_;
+        thread_data_ = nullptr;
+        n_thread_data_ = 0;
+    }
+#endif
     CUDA_DEVICE
     unsigned long long int hash_fun(unsigned long long int k) {
         k ^= k >> 16;
@@ -3,6 +3,12 @@
 
 #include <moqui/base/mqi_common.hpp>
 #include <moqui/base/mqi_math.hpp>
+#if !defined(__CUDACC__)
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <vector>
+#endif
 
 namespace mqi {
 
@@ -15,6 +21,9 @@ struct thrd_t {
 
 ///< random number initialization before entering the  mc loop.
 ///< this can be as a part of the loop also.
+///< On CPU, offset is the stream (beam number) of the counter-based generator.
+///< The caller sets histories to the range of the batch in the beam and the transport
+///< kernel restarts the generator for each history, see mqi::philox_rng.
 CUDA_GLOBAL
 void initialize_threads(mqi::thrd_t* thrds, const uint32_t n_threads, unsigned long master_seed = 0,
                         unsigned long offset = 0) {
@@ -23,12 +32,94 @@ void initialize_threads(mqi::thrd_t* thrds, const uint32_t n_threads, unsigned l
     curand_init(master_seed + blockIdx.x, threadIdx.x, offset, &thrds[thread_id].rnd_generator);
 #else
     for (uint32_t i = 0; i < n_threads; ++i) {
-        std::seed_seq seed{master_seed + i};
-        thrds[i].rnd_generator.seed(master_seed);
+        thrds[i].rnd_generator.set_key(master_seed, offset);
     }
 #endif
 }
 
+#if !defined(__CUDACC__)
+///< Histories [first, last) of a batch, all of one spot
+struct history_task {
+    uint32_t first;
+    uint32_t last;
+};
+
+///< Split a batch into tasks: each run of histories of a spot is cut into
+///< chunks of at most chunk histories, so a spot is never mixed with another in a task.
+inline std::vector<history_task> make_spot_tasks(const uint32_t* scorer_offset_vector,
+                                                 uint32_t n_histories, uint32_t chunk) {
+    std::vector<history_task> tasks;
+    chunk = std::max(chunk, 1u);
+    uint32_t first = 0;
+    while (first < n_histories) {
+        uint32_t end = first + 1;
+        while (end < n_histories && scorer_offset_vector[end] == scorer_offset_vector[first])
+            ++end;
+        for (uint32_t i = first; i < end; i += chunk)
+            tasks.push_back({i, std::min(i + chunk, end)});
+        first = end;
+    }
+    return tasks;
+}
+
+///< Work-stealing scheduler of history tasks for CPU workers.
+///< Each worker starts with a contiguous block of tasks of about the same number of histories,
+///< takes tasks from the front of its own deque and, once it runs out, steals from the back of
+///< the others. Workers that finish early thus take over the tail of slow (e.g., high-MU distal)
+///< spots. No task is added after construction, so a worker stops when every deque is empty.
+///< Tasks are chunks of many histories, so a mutex per deque is enough.
+class task_queue {
+   protected:
+    struct worker_tasks {
+        std::mutex lock;
+        std::deque<history_task> tasks;
+    };
+    std::vector<worker_tasks> workers_;
+
+   public:
+    task_queue(const std::vector<history_task>& tasks, uint32_t n_workers)
+        : workers_(std::max(n_workers, 1u)) {
+        uint64_t total = 0;
+        for (auto& t : tasks)
+            total += t.last - t.first;
+        total = std::max<uint64_t>(total, 1);
+        uint64_t acc = 0;
+        for (auto& t : tasks) {
+            ///< worker of the first history of the task in an even split of histories
+            const size_t w =
+                std::min<uint64_t>(acc * workers_.size() / total, workers_.size() - 1);
+            workers_[w].tasks.push_back(t);
+            acc += t.last - t.first;
+        }
+    }
+
+    ///< Next task of a worker, its own first then stolen from the others
+    ///< \return false if no task is left
+    bool pop(uint32_t worker, history_task& task) {
+        const uint32_t n = workers_.size();
+        {
+            worker_tasks& own = workers_[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (uint32_t k = 1; k < n; ++k) {
+            worker_tasks& victim = workers_[(worker + k) % n];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+#endif
+
 }  // namespace mqi
 
 #endif
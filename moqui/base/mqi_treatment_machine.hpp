@@ -103,7 +103,8 @@ class treatment_machine {
     // Added in 2023 by Chanil Jeon
     virtual mqi::beamlet<T> characterize_beamlet(const mqi::beam_module_ion::logspot& s,
                                                  const float source_to_isocenter_mm,
-                                                 const bool rsuse) = 0;
+                                                 const bool rsuse,
+                                                 mqi::beamlet_arena<T>& arena) = 0;
 };
 
 }  // namespace mqi
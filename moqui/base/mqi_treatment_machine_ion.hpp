@@ -190,7 +190,8 @@ class treatment_machine_ion : public treatment_machine<T> {
 
     virtual mqi::beamlet<T> characterize_beamlet(const mqi::beam_module_ion::logspot& s,
                                                  const float source_to_isocenter_mm,
-                                                 const bool rsuse) = 0;
+                                                 const bool rsuse,
+                                                 mqi::beamlet_arena<T>& arena) = 0;
 
     /// User method to characterize beam delivery time
     /// on_time, off_time by default 1 sec and 0 sec
@@ -0,0 +1,198 @@
+#ifndef MQI_UNIFORM_GRID3D_H
+#define MQI_UNIFORM_GRID3D_H
+
+/// \file
+///
+/// Navigator for uniformly spaced grid3d used in the transport loop
+///
+
+#include <moqui/base/mqi_common.hpp>
+#include <moqui/base/mqi_grid3d.hpp>
+#include <moqui/base/mqi_math.hpp>
+#include <moqui/base/mqi_vec.hpp>
+
+namespace mqi {
+
+/// \class uniform_grid3d
+/// Non-owning view of a grid3d whose axes are uniformly spaced (grid3d::is_uniform).
+/// Edges are computed from the origin and spacing and all member functions are
+/// non-virtual and inline, so the voxel-stepping loop has no indirect calls and no
+/// edge-array loads. It provides the subset of the grid3d interface used by the
+/// transport kernels, see mc::transport_in_node.
+/// \tparam T for grid values, e.g., dose, HU, vector
+/// \tparam R for grid coordinates, float, double, etc.
+template <typename T, typename R>
+class uniform_grid3d {
+   protected:
+    mqi::vec3<ijk_t> dim_;  ///< number of voxels
+    mqi::vec3<R> V000_;     ///< coner x_min, y_min, z_min
+    mqi::vec3<R> d_;        ///< voxel size
+    mqi::vec3<R> inv_d_;    ///< inverse of voxel size
+    T* data_ = nullptr;     ///< data of the viewed grid
+    grid3d<T, R>* geo_;     ///< viewed grid for the rarely used paths
+
+    ///< edge position of axis with origin o and spacing d
+    CUDA_HOST_DEVICE
+    inline static R edge(const R o, const R d, const ijk_t i) { return o + i * d; }
+
+    ///< same boundary rules as grid3d::index_axis
+    CUDA_HOST_DEVICE
+    inline static ijk_t
+    index_axis(const R o, const R d, const R inv_d, const ijk_t n, const R p, const R dir) {
+        R f = (p - mqi::geometry_tolerance - o) * inv_d;
+        ijk_t ind = (f < 1) ? 0 : (f >= n) ? n - 1 : ijk_t(f) - 1;
+        for (; ind < n; ++ind) {
+            const R e0 = edge(o, d, ind);
+            const R e1 = edge(o, d, ind + 1);
+            if (mqi::mqi_abs(e0 - p) < mqi::geometry_tolerance) {
+                return (dir < 0) ? ind - 1 : ind;
+            } else if (mqi::mqi_abs(e1 - p) < mqi::geometry_tolerance) {
+                return (dir > 0) ? ind + 1 : ind;
+            } else if (e0 - p < 0 && e1 - p > 0) {
+                return ind;
+            } else if (e0 - p >= mqi::geometry_tolerance) {
+                break;
+            }
+        }
+        return -1;
+    }
+
+   public:
+    mqi::mat3x3<R> rotation_matrix_fwd;
+    mqi::mat3x3<R> rotation_matrix_inv;
+    mqi::vec3<R> translation_vector;
+
+    CUDA_HOST_DEVICE
+    uniform_grid3d(grid3d<T, R>& g)
+        : geo_(&g),
+          rotation_matrix_fwd(g.rotation_matrix_fwd),
+          rotation_matrix_inv(g.rotation_matrix_inv),
+          translation_vector(g.translation_vector) {
+        dim_ = g.get_nxyz();
+        const R* xe = g.get_x_edges();
+        const R* ye = g.get_y_edges();
+        const R* ze = g.get_z_edges();
+        V000_.x = xe[0];
+        V000_.y = ye[0];
+        V000_.z = ze[0];
+        d_.x = (xe[dim_.x] - xe[0]) / dim_.x;
+        d_.y = (ye[dim_.y] - ye[0]) / dim_.y;
+        d_.z = (ze[dim_.z] - ze[0]) / dim_.z;
+        inv_d_.x = 1.0 / d_.x;
+        inv_d_.y = 1.0 / d_.y;
+        inv_d_.z = 1.0 / d_.z;
+        data_ = g.get_data();
+    }
+
+    CUDA_HOST_DEVICE
+    inline mqi::vec3<ijk_t> get_nxyz() const { return dim_; }
+
+    CUDA_HOST_DEVICE
+    inline const T operator[](const mqi::cnb_t p) const { return data_[p]; }
+
+    CUDA_HOST_DEVICE
+    inline cnb_t ijk2cnb(const vec3<ijk_t>& idx) const {
+        return idx.z * dim_.x * dim_.y + idx.y * dim_.x + idx.x;
+    }
+
+    CUDA_HOST_DEVICE
+    inline bool is_valid(const mqi::vec3<ijk_t>& c) const {
+        return c.x >= 0 && c.y >= 0 && c.z >= 0 && c.x < dim_.x && c.y < dim_.y && c.z < dim_.z;
+    }
+
+    ///< index of the voxel entered at p, see grid3d::index
+    CUDA_HOST_DEVICE
+    inline mqi::vec3<ijk_t> index(const mqi::vec3<R>& p, const mqi::vec3<R>& dir) const {
+        mqi::vec3<ijk_t> idx;
+        idx.x = index_axis(V000_.x, d_.x, inv_d_.x, dim_.x, p.x, dir.x);
+        idx.y = index_axis(V000_.y, d_.y, inv_d_.y, dim_.y, p.y, dir.y);
+        idx.z = index_axis(V000_.z, d_.z, inv_d_.z, dim_.z, p.z, dir.z);
+        return idx;
+    }
+
+    ///< update index after a step, see grid3d::index
+    CUDA_HOST_DEVICE
+    inline void index(const mqi::vec3<R>& vtx1, const mqi::vec3<R>& dir1,
+                      mqi::vec3<ijk_t>& idx) const {
+        const mqi::vec3<R> e0(edge(V000_.x, d_.x, idx.x), edge(V000_.y, d_.y, idx.y),
+                              edge(V000_.z, d_.z, idx.z));
+        const mqi::vec3<R> e1 = e0 + d_;
+        if (dir1.x < 0 && (mqi::mqi_abs(vtx1.x - e0.x) < mqi::geometry_tolerance || vtx1.x < e0.x)) {
+            idx.x -= 1;
+        } else if (dir1.x > 0 &&
+                   (mqi::mqi_abs(vtx1.x - e1.x) < mqi::geometry_tolerance || vtx1.x > e1.x)) {
+            idx.x += 1;
+        }
+        if (dir1.y < 0 && (mqi::mqi_abs(vtx1.y - e0.y) < mqi::geometry_tolerance || vtx1.y < e0.y)) {
+            idx.y -= 1;
+        } else if (dir1.y > 0 &&
+                   (mqi::mqi_abs(vtx1.y - e1.y) < mqi::geometry_tolerance || vtx1.y > e1.y)) {
+            idx.y += 1;
+        }
+        if (dir1.z < 0 && (mqi::mqi_abs(vtx1.z - e0.z) < mqi::geometry_tolerance || vtx1.z < e0.z)) {
+            idx.z -= 1;
+        } else if (dir1.z > 0 &&
+                   (mqi::mqi_abs(vtx1.z - e1.z) < mqi::geometry_tolerance || vtx1.z > e1.z)) {
+            idx.z += 1;
+        }
+    }
+
+    ///< ray from outside, rarely called so it is forwarded to the grid
+    CUDA_HOST_DEVICE
+    inline intersect_t<R> intersect(mqi::vec3<R>& p, mqi::vec3<R>& d) {
+        return geo_->intersect(p, d);
+    }
+
+    ///< distance to the boundary of voxel idx, see grid3d::intersect
+    CUDA_HOST_DEVICE
+    inline intersect_t<R> intersect(mqi::vec3<R>& p, mqi::vec3<R>& d, mqi::vec3<ijk_t>& idx) {
+        mqi::intersect_t<R> its;
+        its.cell = idx;
+        its.side = mqi::NONE_XYZ_PLANE;
+        const mqi::vec3<R> vox1(edge(V000_.x, d_.x, idx.x), edge(V000_.y, d_.y, idx.y),
+                                edge(V000_.z, d_.z, idx.z));
+        const mqi::vec3<R> vox2 = vox1 + d_;
+        mqi::vec3<R> t_max;
+        t_max.x = axis_exit(p.x, d.x, vox1.x, vox2.x, idx.x, dim_.x);
+        t_max.y = axis_exit(p.y, d.y, vox1.y, vox2.y, idx.y, dim_.y);
+        t_max.z = axis_exit(p.z, d.z, vox1.z, vox2.z, idx.z, dim_.z);
+        R u_max;
+        if (t_max.x < t_max.y) {
+            u_max = (t_max.x < t_max.z) ? t_max.x : t_max.z;
+        } else {
+            u_max = (t_max.y < t_max.z) ? t_max.y : t_max.z;
+        }
+        if (u_max > 0) {
+            its.dist = u_max;
+            return its;
+        }
+        its.dist = -1.0;
+        its.cell.x = -1;
+        its.cell.y = -1;
+        its.cell.z = -1;
+        return its;
+    }
+
+   protected:
+    ///< exit distance along one axis, direction component below near_zero is zeroed
+    CUDA_HOST_DEVICE
+    inline static R
+    axis_exit(const R p, R& d, const R v1, const R v2, const ijk_t i, const ijk_t n) {
+        if (d * d > mqi::near_zero) {
+            if (d < 0) {
+                if (mqi::mqi_abs(-(p - v1) / d) < mqi::geometry_tolerance && i > 0)
+                    return 1 / mqi::geometry_tolerance;
+                return -(p - v1) / d;
+            }
+            if (mqi::mqi_abs((v2 - p) / d) < mqi::geometry_tolerance && i < n)
+                return 1 / mqi::geometry_tolerance;
+            return (v2 - p) / d;
+        }
+        d = 0;
+        return mqi::p_inf;
+    }
+};
+
+}  // namespace mqi
+
+#endif
@@ -1,13 +1,17 @@
 #ifndef MQI_TRANSPORT_HPP
 #define MQI_TRANSPORT_HPP
 
+#include <atomic>
 #include <cassert>
+#include <moqui/base/mqi_beamsource.hpp>
 #include <moqui/base/mqi_error_check.hpp>
 #include <moqui/base/mqi_fippel_physics.hpp>
 #include <moqui/base/mqi_material.hpp>
 #include <moqui/base/mqi_node.hpp>
+#include <moqui/base/mqi_scorer.hpp>
 #include <moqui/base/mqi_threads.hpp>
 #include <moqui/base/mqi_track.hpp>
+#include <moqui/base/mqi_uniform_grid3d.hpp>
 #include <moqui/base/mqi_utils.hpp>
 #include <moqui/base/mqi_vertex.hpp>
 
@@ -41,6 +45,19 @@ uint32_t CAS(uint32_t* address, uint32_t compare, uint32_t val) {
     return old;
 }
 
+///< Add value to a dense scorer array, see scorer::dense_data_
+CUDA_DEVICE
+inline void insert_dense(double* dense, mqi::cnb_t cnb, double value) {
+    if (value <= 0) {
+        return;
+    }
+#if defined(__CUDACC__)
+    atomicAdd(&dense[cnb], value);
+#else
+    std::atomic_ref<double>(dense[cnb]).fetch_add(value, std::memory_order_relaxed);
+#endif
+}
+
 template <typename R>
 CUDA_DEVICE void insert_hashtable(mqi::key_value* hashtable, mqi::key_t key1, mqi::key_t key2,
                                   double value, unsigned long long int scorer_offset,
@@ -58,62 +75,177 @@ CUDA_DEVICE void insert_hashtable(mqi::key_value* hashtable, mqi::key_t key1, mq
 
     uint32_t prev1, prev2;
     while (true) {
+        ///< key2 is only claimed once key1 belongs to us, otherwise a slot owned by
+        ///< another key1 could be left with our key2
 #if defined(__CUDACC__)
         prev1 = atomicCAS(&hashtable[slot].key1, mqi::empty_pair, key1);
-        prev2 = atomicCAS(&hashtable[slot].key2, mqi::empty_pair, key2);
+        if (prev1 == mqi::empty_pair || prev1 == key1) {
+            prev2 = atomicCAS(&hashtable[slot].key2, mqi::empty_pair, key2);
+            if (prev2 == mqi::empty_pair || prev2 == key2) {
+                atomicAdd(&hashtable[slot].value, value);
+                return;
+            }
+        }
 #else
-        prev1 = CAS(&hashtable[slot].key1, mqi::empty_pair, key1);
-        prev2 = CAS(&hashtable[slot].key2, mqi::empty_pair, key2);
+        ///< lock-free on CPU: CPU worker threads share the same table
+        prev1 = mqi::empty_pair;
+        std::atomic_ref<mqi::key_t>(hashtable[slot].key1).compare_exchange_strong(prev1, key1);
+        if (prev1 == mqi::empty_pair || prev1 == key1) {
+            prev2 = mqi::empty_pair;
+            std::atomic_ref<mqi::key_t>(hashtable[slot].key2).compare_exchange_strong(prev2,
+                                                                                       key2);
+            if (prev2 == mqi::empty_pair || prev2 == key2) {
+                std::atomic_ref<double>(hashtable[slot].value)
+                    .fetch_add(value, std::memory_order_relaxed);
+                return;
+            }
+        }
 #endif
-        if ((prev1 == mqi::empty_pair || prev1 == key1) &&
-            (prev2 == mqi::empty_pair || prev2 == key2)) {
-#if defined(__CUDACC__)
-            atomicAdd(&hashtable[slot].value, value);
+        slot = (slot + 1) % (max_capacity);
+    }
+}
+
+///< Transport a track through one child node until it leaves the node or stops.
+///< G is the navigator of the node geometry, grid3d or uniform_grid3d, and geo is
+///< the node geometry itself which is handed to the scorers.
+template <typename R, typename G>
+CUDA_DEVICE void transport_in_node(G& c_geo, mqi::grid3d<mqi::density_t, R>& geo,
+                                   mqi::track_t<R>& track, mqi::track_stack_t<R>& stack,
+                                   mqi::fippel_physics<R>& fippel, mqi::h2o_t<R>& water,
+                                   mqi::mqi_rng* thread_rng, uint32_t spot_ind,
+                                   bool score_local_deposit, uint32_t thread_id) {
+    mqi::vec3<mqi::ijk_t> index_checker;
+    mqi::cnb_t cnb;  //< child number
+    R rho_mass = 1e-3;
+    uint8_t nb_of_scorers = track.c_node->n_scorers;
+    track.vtx0.pos = c_geo.rotation_matrix_inv *
+                     (track.vtx0.pos - c_geo.translation_vector);  // rotate the vertex
+    track.vtx0.dir = c_geo.rotation_matrix_inv * (track.vtx0.dir);  // rotate the vertex
+    track.vtx0.dir.normalize();
+    track.vtx1.pos = track.vtx0.pos;
+    track.vtx1.dir = track.vtx0.dir;
+    index_checker = c_geo.index(track.vtx0.pos, track.vtx0.dir);
+    if (!c_geo.is_valid(index_checker)) {
+        track.its = c_geo.intersect(track.vtx0.pos, track.vtx0.dir);  // The first intersection
+        if (track.its.dist < 0) {
+            track.vtx0.pos = c_geo.rotation_matrix_fwd * (track.vtx0.pos) + c_geo.translation_vector;
+            track.vtx0.dir = c_geo.rotation_matrix_fwd * (track.vtx0.dir);  // rotate the vertex
+            track.vtx1.pos = track.vtx0.pos;
+            track.vtx1.dir = track.vtx0.dir;
+            return;
+        }
+        track.update_post_vertex_position(track.its.dist);
+        track.move();
+        track.its.cell = c_geo.index(track.vtx0.pos, track.vtx0.dir);
+    } else {
+        track.its.dist = 0.0;
+        track.its.cell = index_checker;
+    }
+    const mqi::body_mask_t<R>* body = track.c_node->body_mask;
+    while (c_geo.is_valid(track.its.cell) && !track.is_stopped()) {
+        cnb = c_geo.ijk2cnb(track.its.cell);
+        track.its = c_geo.intersect(track.vtx0.pos, track.vtx0.dir, track.its.cell);
+        bool skipped = false;
+        if (body && body->distance[cnb] > 0) {
+            ///< outside of the body: nothing to do once the body is behind the track,
+            ///< otherwise cross the air around the voxel in one step
+            if (!body->is_ahead(track.vtx0.pos, track.vtx0.dir)) {
+                track.stop();
+                break;
+            }
+            ///< a step shorter than (distance - 1) voxels never reaches the body
+            R skip = (body->distance[cnb] - 1) * body->min_spacing * R(0.999);
+            if (skip > track.its.dist) {
+                track.its.dist = skip;
+                skipped = true;
+            }
+        }
+        rho_mass = c_geo[cnb];
+
+        water.rho_mass = rho_mass;
+#ifdef __PHYSICS_DEBUG__
+        if (!track.primary && track.dE > 0) {
+            track.stop();
+        } else {
+            fippel.stepping(track, stack, thread_rng, rho_mass, water, track.its.dist,
+                            score_local_deposit);
+        }
 #else
-            hashtable[slot].value += value;
+        fippel.stepping(track, stack, thread_rng, rho_mass, water, track.its.dist,
+                        score_local_deposit);
 #endif
-            return;
+        if (track.its.dist < 0)
+            break;
+        for (uint8_t s = 0; s < nb_of_scorers; ++s) {
+            if (track.c_node->scorers[s]->roi_->idx(cnb) > 0) {
+#if !defined(__CUDACC__)
+                ///< private accumulator of this thread, no atomics
+                if (track.c_node->scorers[s]->thread_data_ && spot_ind == mqi::empty_pair) {
+                    double hit = track.c_node->scorers[s]->compute_hit_(track, cnb, geo);
+                    if (hit > 0)
+                        track.c_node->scorers[s]->thread_data_[thread_id][cnb] += hit;
+                    continue;
+                }
+#endif
+                if (track.c_node->scorers[s]->dense_data_ && spot_ind == mqi::empty_pair) {
+                    insert_dense(track.c_node->scorers[s]->dense_data_, cnb,
+                                 track.c_node->scorers[s]->compute_hit_(track, cnb, geo));
+                    continue;
+                }
+                insert_hashtable<R>(track.c_node->scorers[s]->data_, cnb, spot_ind,
+                                    track.c_node->scorers[s]->compute_hit_(track, cnb, geo),
+                                    c_geo.get_nxyz().x * c_geo.get_nxyz().y * c_geo.get_nxyz().z,
+                                    track.c_node->scorers[s]->max_capacity_);
+            }
+        }
+
+        if (!track.is_stopped()) {
+            if (skipped) {
+                track.its.cell = c_geo.index(track.vtx1.pos, track.vtx1.dir);
+            } else {
+                c_geo.index(track.vtx1.pos, track.vtx1.dir,
+                            track.its.cell);  // update the cell index of the particle
+            }
+            track.move();
         }
-        slot = (slot + 1) % (max_capacity);
     }
+    track.vtx0.pos = c_geo.rotation_matrix_fwd * track.vtx0.pos + c_geo.translation_vector;
+    track.vtx0.dir = c_geo.rotation_matrix_fwd * track.vtx0.dir;  // rotate the vertex
+    track.vtx1.pos = track.vtx0.pos;
+    track.vtx1.dir = track.vtx0.dir;
 }
 
+///< Transport histories [first, last) of a batch with the generator of thread_id
 template <typename R>
-CUDA_GLOBAL void transport_particles_patient(mqi::thrd_t* threads, mqi::node_t<R>* world,
-                                             mqi::vertex_t<R>* vertices, const uint32_t n_vtx,
-                                             uint32_t* tracked_particles,
-                                             uint32_t* scorer_offset_vector = nullptr,
-                                             bool score_local_deposit = true,
-                                             uint32_t total_threads = 1,  // # of CPU threads
-                                             uint32_t thread_id = 0)      // CPU thread-id
-{
-#if defined(__CUDACC__)
-    ///< Thread id and total number of threads are replaced in CUDA
-    thread_id = blockIdx.x * blockDim.x + threadIdx.x;
-    total_threads = (blockDim.x * gridDim.x);
-#endif
-
-    const mqi::vec2<uint32_t> h_range = mqi::start_and_length(total_threads, n_vtx, thread_id);
+CUDA_DEVICE void transport_histories(mqi::thrd_t* threads, mqi::node_t<R>* world,
+                                     mqi::vertex_t<R>* vertices, uint32_t first, uint32_t last,
+                                     uint32_t* tracked_particles, uint32_t* scorer_offset_vector,
+                                     bool score_local_deposit, uint32_t thread_id,
+                                     const mqi::beamsource<R>* source) {
     mqi::mqi_rng* thread_rng = &threads[thread_id].rnd_generator;
     R process;
     mqi::fippel_physics<R> fippel;
     mqi::h2o_t<R> water;  // 1e-3 g/mm^3
     uint32_t spot_ind;
     uint32_t c_ind;
-    mqi::vec3<mqi::ijk_t> index_checker;
-    mqi::intersect_t<R> its;
-    mqi::dL_t<R> Lmin;
-    mqi::cnb_t cnb;         //< child number
-    uint8_t nb_of_scorers;  //< scorer number
-    R rho_mass = 1e-3;
     ///< count for physics process rates
-    for (uint32_t i = h_range.x; i < h_range.x + h_range.y; ++i) {
+    for (uint32_t i = first; i < last; ++i) {
+#if !defined(__CUDACC__)
+        ///< every history has its own random sequence, see mqi::initialize_threads
+        const uint64_t history = uint64_t(threads[thread_id].histories[0]) + i;
+        thread_rng->set_history(history);
+#endif
         if (scorer_offset_vector) {
             spot_ind = scorer_offset_vector[i];
         } else {
             spot_ind = mqi::empty_pair;
         }
+#if defined(__CUDACC__)
         mqi::track_t<R> primary(vertices[i]);
+#else
+        ///< with a source, the primary is sampled here from the history's own sequence
+        mqi::track_t<R> primary(source ? source->beamlet_of(history)(thread_rng) : vertices[i]);
+#endif
         mqi::track_stack_t<R> stack;
         stack.push_secondary(primary);
 
@@ -123,100 +255,103 @@ CUDA_GLOBAL void transport_particles_patient(mqi::thrd_t* threads, mqi::node_t<R
             for (c_ind = 0; c_ind < world->n_children; c_ind++) {
                 mqi::grid3d<mqi::density_t, R>& c_geo = *(world->children[c_ind]->geo);
                 track.c_node = world->children[c_ind];
-                nb_of_scorers = track.c_node->n_scorers;
-                //                track.vtx0.pos =c_geo.rotation_matrix_inv * (track.vtx0.pos -
-                //                c_geo.translation_vector) +c_geo.translation_vector;   // rotate
-                //                the vertex track.vtx0.dir =c_geo.rotation_matrix_inv *
-                //                (track.vtx0.dir);   // rotate the vertex
-                track.vtx0.pos =
-                    c_geo.rotation_matrix_inv *
-                    (track.vtx0.pos -
-                     c_geo
-                         .translation_vector);  // +c_geo.translation_vector;   // rotate the vertex
-                track.vtx0.dir = c_geo.rotation_matrix_inv * (track.vtx0.dir);  // rotate the vertex
-                track.vtx0.dir.normalize();
-                track.vtx1.pos = track.vtx0.pos;
-                track.vtx1.dir = track.vtx0.dir;
-                index_checker = c_geo.index(track.vtx0.pos, track.vtx0.dir);
-                if (!c_geo.is_valid(index_checker)) {
-                    track.its =
-                        c_geo.intersect(track.vtx0.pos, track.vtx0.dir);  // The first intersection
-                    if (track.its.dist < 0) {
-                        //                        track.vtx0.pos = c_geo.rotation_matrix_fwd *
-                        //                        (track.vtx0.pos - c_geo.translation_vector) +
-                        //                        c_geo.translation_vector; track.vtx0.dir =
-                        //                        c_geo.rotation_matrix_fwd * (track.vtx0.dir);   //
-                        //                        rotate the vertex
-                        track.vtx0.pos =
-                            c_geo.rotation_matrix_fwd * (track.vtx0.pos) + c_geo.translation_vector;
-                        track.vtx0.dir =
-                            c_geo.rotation_matrix_fwd * (track.vtx0.dir);  // rotate the vertex
-                        track.vtx1.pos = track.vtx0.pos;
-                        track.vtx1.dir = track.vtx0.dir;
-                        continue;
-                    }
-                    track.update_post_vertex_position(track.its.dist);
-                    track.move();
-                    track.its.cell = c_geo.index(track.vtx0.pos, track.vtx0.dir);
+                if (c_geo.is_uniform()) {
+                    mqi::uniform_grid3d<mqi::density_t, R> u_geo(c_geo);
+                    transport_in_node<R>(u_geo, c_geo, track, stack, fippel, water, thread_rng,
+                                         spot_ind, score_local_deposit, thread_id);
                 } else {
-                    track.its.dist = 0.0;
-                    track.its.cell = index_checker;
+                    transport_in_node<R>(c_geo, c_geo, track, stack, fippel, water, thread_rng,
+                                         spot_ind, score_local_deposit, thread_id);
                 }
-                while (c_geo.is_valid(track.its.cell) && !track.is_stopped()) {
-                    cnb = c_geo.ijk2cnb(track.its.cell);
-                    track.its = c_geo.intersect(track.vtx0.pos, track.vtx0.dir, track.its.cell);
-                    rho_mass = c_geo[cnb];
-
-                    water.rho_mass = rho_mass;
-#ifdef __PHYSICS_DEBUG__
-                    if (!track.primary && track.dE > 0) {
-                        track.stop();
-                    } else {
-                        fippel.stepping(track, stack, thread_rng, rho_mass, water, track.its.dist,
-                                        score_local_deposit);
-                    }
-#else
-                    fippel.stepping(track, stack, thread_rng, rho_mass, water, track.its.dist,
-                                    score_local_deposit);
-#endif
-                    if (track.its.dist < 0)
-                        break;
-                    for (uint8_t s = 0; s < nb_of_scorers; ++s) {
-                        if (track.c_node->scorers[s]->roi_->idx(cnb) > 0) {
-                            insert_hashtable<R>(
-                                track.c_node->scorers[s]->data_, cnb, spot_ind,
-                                track.c_node->scorers[s]->compute_hit_(track, cnb, c_geo),
-                                c_geo.get_nxyz().x * c_geo.get_nxyz().y * c_geo.get_nxyz().z,
-                                track.c_node->scorers[s]->max_capacity_);
-                        }
-                    }
-
-                    if (!track.is_stopped()) {
-                        c_geo.index(track.vtx1.pos, track.vtx1.dir,
-                                    track.its.cell);  // update the cell index of the particle
-                        track.move();
-                    }
-                }
-                //                track.vtx0.pos = c_geo.rotation_matrix_fwd * (track.vtx0.pos -
-                //                c_geo.translation_vector) + c_geo.translation_vector;
-                //                track.vtx0.dir = c_geo.rotation_matrix_fwd * (track.vtx0.dir); //
-                //                rotate the vertex
-                track.vtx0.pos =
-                    c_geo.rotation_matrix_fwd * track.vtx0.pos + c_geo.translation_vector;
-                track.vtx0.dir = c_geo.rotation_matrix_fwd * track.vtx0.dir;  // rotate the vertex
-                track.vtx1.pos = track.vtx0.pos;
-                track.vtx1.dir = track.vtx0.dir;
             }  // while(history is out-of-world or zero energy
 
         }  // while(stack is not empty)
 #if defined(__CUDACC__)
         atomicAdd(tracked_particles, 1);
 #else
-        tracked_particles[0] += 1;
+        std::atomic_ref<uint32_t>(tracked_particles[0]).fetch_add(1, std::memory_order_relaxed);
 #endif
     }  // for
+}  // transport_histories
+
+template <typename R>
+CUDA_GLOBAL void transport_particles_patient(mqi::thrd_t* threads, mqi::node_t<R>* world,
+                                             mqi::vertex_t<R>* vertices, const uint32_t n_vtx,
+                                             uint32_t* tracked_particles,
+                                             uint32_t* scorer_offset_vector = nullptr,
+                                             bool score_local_deposit = true,
+                                             uint32_t total_threads = 1,  // # of CPU threads
+                                             uint32_t thread_id = 0,      // CPU thread-id
+                                             const mqi::beamsource<R>* source = nullptr)  // CPU
+{
+#if defined(__CUDACC__)
+    ///< Thread id and total number of threads are replaced in CUDA
+    thread_id = blockIdx.x * blockDim.x + threadIdx.x;
+    total_threads = (blockDim.x * gridDim.x);
+#endif
+
+    const mqi::vec2<uint32_t> h_range = mqi::start_and_length(total_threads, n_vtx, thread_id);
+    transport_histories<R>(threads, world, vertices, h_range.x, h_range.x + h_range.y,
+                           tracked_particles, scorer_offset_vector, score_local_deposit, thread_id,
+                           source);
 }  // transport_particles_table
 
+#if !defined(__CUDACC__)
+///< CPU worker transporting (spot, history chunk) tasks of a work-stealing queue.
+///< Every history restarts its own generator, so the result does not depend on which
+///< worker takes a task.
+template <typename R>
+CUDA_HOST void transport_particles_patient_tasks(mqi::thrd_t* threads, mqi::node_t<R>* world,
+                                                 mqi::vertex_t<R>* vertices,
+                                                 mqi::task_queue* queue,
+                                                 uint32_t* tracked_particles,
+                                                 uint32_t* scorer_offset_vector,
+                                                 bool score_local_deposit, uint32_t thread_id,
+                                                 const mqi::beamsource<R>* source = nullptr) {
+    mqi::history_task task;
+    while (queue->pop(thread_id, task)) {
+        transport_histories<R>(threads, world, vertices, task.first, task.last,
+                               tracked_particles, scorer_offset_vector, score_local_deposit,
+                               thread_id, source);
+    }
+}
+#endif
+
+#if !defined(__CUDACC__)
+///< Merge private per-thread accumulators of a scorer into its hash table.
+///< Every worker handles a contiguous range of voxels and sums the n_buffers buffers
+///< in a fixed pairwise tree order, so the result does not depend on the scheduling.
+///< The sum goes to dense_data_ if the scorer has one. The buffers are zeroed for the next batch.
+template <typename R>
+CUDA_HOST void reduce_thread_data(mqi::scorer<R>* scr, uint32_t n_buffers,
+                                  uint32_t total_threads = 1, uint32_t thread_id = 0) {
+    const mqi::vec2<uint32_t> v_range =
+        mqi::start_and_length(total_threads, scr->max_capacity_, thread_id);
+    double** buf = scr->thread_data_;
+    for (uint32_t stride = 1; stride < n_buffers; stride *= 2) {
+        for (uint32_t i = 0; i + stride < n_buffers; i += 2 * stride) {
+            double* dst = buf[i];
+            double* src = buf[i + stride];
+            for (uint32_t v = v_range.x; v < v_range.x + v_range.y; ++v) {
+                dst[v] += src[v];
+                src[v] = 0;
+            }
+        }
+    }
+    for (uint32_t v = v_range.x; v < v_range.x + v_range.y; ++v) {
+        if (buf[0][v] > 0) {
+            if (scr->dense_data_) {
+                scr->dense_data_[v] += buf[0][v];
+            } else {
+                insert_hashtable<R>(scr->data_, v, mqi::empty_pair, buf[0][v], 0,
+                                    scr->max_capacity_);
+            }
+            buf[0][v] = 0;
+        }
+    }
+}
+#endif
+
 template <typename R>
 CUDA_GLOBAL void transport_particles_patient_seed(
     mqi::thrd_t* threads, mqi::node_t<R>* world, mqi::vertex_t<R>* vertices, const uint32_t n_vtx,
@@ -250,6 +385,9 @@ CUDA_GLOBAL void transport_particles_patient_seed(
     for (uint32_t i = h_range.x; i < h_range.x + h_range.y; ++i) {
 #if defined(__CUDACC__)
         curand_init(transport_seed[i], 0, 0, thread_rng);
+#else
+        ///< every history has its own random sequence, see mqi::initialize_threads
+        thread_rng->set_history(uint64_t(threads[thread_id].histories[0]) + i);
 #endif
         if (scorer_offset_vector) {
             spot_ind = scorer_offset_vector[i];
@@ -356,7 +494,7 @@ CUDA_GLOBAL void transport_particles_patient_seed(
 #if defined(__CUDACC__)
         atomicAdd(tracked_particles, 1);
 #else
-        tracked_particles[0] += 1;
+        std::atomic_ref<uint32_t>(tracked_particles[0]).fetch_add(1, std::memory_order_relaxed);
 #endif
     }  // for
 }  // transport_particles_table
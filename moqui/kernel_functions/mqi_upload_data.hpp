@@ -49,13 +49,14 @@ void upload_beamsource(mqi::beamsource<R> src, mqi::beamsource<R>*& dest) {
     gpu_err_chk(cudaMemcpy(dest, &src, sizeof(mqi::beamsource<R>), cudaMemcpyHostToDevice));
     size_t* d_cdf;
     size_t* d_beamlet;
-    gpu_err_chk(cudaMalloc(&d_cdf, src.beamlet_size_ * sizeof(size_t)));
-    gpu_err_chk(cudaMemcpy(d_cdf, src.array_cdf_, src.beamlet_size_ * sizeof(size_t),
-                           cudaMemcpyHostToDevice));
-    gpu_err_chk(cudaMalloc(&d_beamlet, src.beamlet_size_ * sizeof(size_t)));
-    gpu_err_chk(cudaMemcpy(d_beamlet, src.array_beamlet_, src.beamlet_size_ * sizeof(size_t),
+    const size_t n_cdf = src.cdf_.size();
+    gpu_err_chk(cudaMalloc(&d_cdf, n_cdf * sizeof(size_t)));
+    gpu_err_chk(
+        cudaMemcpy(d_cdf, src.cdf_.data(), n_cdf * sizeof(size_t), cudaMemcpyHostToDevice));
+    gpu_err_chk(cudaMalloc(&d_beamlet, n_cdf * sizeof(size_t)));
+    gpu_err_chk(cudaMemcpy(d_beamlet, src.cdf_beamlet_.data(), n_cdf * sizeof(size_t),
                            cudaMemcpyHostToDevice));
-    add_beamlet<R><<<1, 1>>>(dest, d_cdf, d_beamlet, src.beamlet_size_);
+    add_beamlet<R><<<1, 1>>>(dest, d_cdf, d_beamlet, n_cdf);
     mqi::check_cuda_last_error("(add beamlet)");
     //    for (int i = 0; i < src.beamlet_size_; i++) {
     //        printf("cdf cpu %d %d %d\n", i, src.array_cdf_[i], src.array_beamlet_[i]);
@@ -82,6 +83,7 @@ CUDA_GLOBAL void add_node_geometry(mqi::node_t<R>* node, R* xe, mqi::ijk_t nxe,
     node->children = children;
     node->n_scorers = 0;
     node->scorers_data = nullptr;
+    node->body_mask = nullptr;  ///< transport culling by body contour is CPU only
     // if (n_children >= 1) { printf("children:%d\n", n_children); }
     printf("Adding geometry node.. : Node --> %p, number of children --> %d\n", node, n_children);
 
@@ -43,6 +43,18 @@ class gtr2 : public treatment_machine_ion<T> {
     tk::spline beamAngularSpreadInterp;
     tk::spline beamDivergenceInterp;
 
+    // Beam model at the energy of the last layer
+    // Spots of a layer share one energy, so the splines are evaluated once per layer
+    struct layer_model_t {
+        float e = -1;
+        double protonPerDose;
+        double dosePerMUCount;
+        double beamEnergySpread;
+        double beamSpotSize;
+        double beamAngularSpread;
+        double beamDivergence;
+    } layerModel;
+
     // Samsung Medical Center focal length value in Raystation
     // Added in 2023-08 by Chanil Jeon
     gtr2() {
@@ -141,21 +153,38 @@ class gtr2 : public treatment_machine_ion<T> {
         return mqi::beamlet<T>();
     }
 
+    // Beam model at energy e, evaluated again only when the energy changes
+    const layer_model_t& layer_model(float e) {
+        if (e != layerModel.e) {
+            layerModel.e = e;
+            layerModel.protonPerDose = protonPerDoseInterp(e);
+            layerModel.dosePerMUCount = dosePerMUCountInterp(e);
+            layerModel.beamEnergySpread = beamEnergySpreadInterp(e);
+            layerModel.beamSpotSize = beamSpotSizeInterp(e);
+            layerModel.beamAngularSpread = beamAngularSpreadInterp(e);
+            layerModel.beamDivergence = beamDivergenceInterp(e);
+        }
+        return layerModel;
+    }
+
     // Log file MU count to particle count conversion formula used in TOPAS MC
     // Particle count in MC = MU Count * (Dose / MU Count) * (Particle / dose) * (Dose monitor
     // range--> implemented in pre-program)
     size_t characterize_history(const mqi::beam_module_ion::logspot& s) {
         /* SMC Log file version */
-        int particleFromMUCount = s.muCount * protonPerDoseInterp(s.e) *
-                                  dosePerMUCountInterp(s.e);  //* scaleFactorCorrectionInterp(s.e);
+        const layer_model_t& model = this->layer_model(s.e);
+        int particleFromMUCount = s.muCount * model.protonPerDose *
+                                  model.dosePerMUCount;  //* scaleFactorCorrectionInterp(s.e);
         return particleFromMUCount;
     }
 
     // Characterize beamlet information using log file information
     // Using mqi::beam_module_ion::logspot, with an added feature in mqi_beam_module_ion
     // Added by Chanil Jeon
+    // Distributions are stored by value in the arena of the beam source
     mqi::beamlet<T> characterize_beamlet(const mqi::beam_module_ion::logspot& s,
-                                         const float source_to_isocenter_mm, const bool rsuse) {
+                                         const float source_to_isocenter_mm, const bool rsuse,
+                                         mqi::beamlet_arena<T>& arena) {
         // Range shifter correction
         float newBeamStartingPos{-source_to_isocenter_mm};
         if (rsuse)
@@ -163,10 +192,11 @@ class gtr2 : public treatment_machine_ion<T> {
 
         // Spot beam's energy
         // Constant energy
-        double energySpread = this->beamEnergySpreadInterp(s.e);
+        const layer_model_t& model = this->layer_model(s.e);
+        double energySpread = model.beamEnergySpread;
 
         // Gaussian energy spread distribution
-        auto energy = new mqi::norm_1d<T>({s.e}, {energySpread});
+        mqi::norm_1d<T> energy(std::array<T, 1>{s.e}, std::array<T, 1>{T(energySpread)});
 
         // Caculate direction based on SAD and spot's position
         mqi::vec3<T> dir(std::atan(s.x / treatment_machine_ion<T>::SAD_[0]),
@@ -178,22 +208,22 @@ class gtr2 : public treatment_machine_ion<T> {
         pos.y = (treatment_machine_ion<T>::SAD_[1] - pos.z) * dir.y;
 
         // Spot size interpolation equation (70-230 MeV)
-        double spotSize = this->beamSpotSizeInterp(s.e);
+        double spotSize = model.beamSpotSize;
 
         // Angular spread interpolation equation (70-230 MeV)
-        double angularSpread = this->beamAngularSpreadInterp(s.e);
+        double angularSpread = model.beamAngularSpread;
 
         // Divergence interpolation equation (70-230 MeV)
-        double divergence = this->beamDivergenceInterp(s.e);
+        double divergence = model.beamDivergence;
 
         // Define phsp distribution
         std::array<T, 6> beamlet_mean = {pos.x, pos.y, pos.z, dir.x, dir.y, dir.z};
         std::array<T, 6> beamlet_sigm = {spotSize, spotSize, 0, angularSpread, angularSpread, 0};
         std::array<T, 2> beamlet_divergence = {divergence, divergence};
-        auto beamlet = new mqi::phsp_6d_ray<T>(beamlet_mean, beamlet_sigm, beamlet_divergence,
-                                               newBeamStartingPos);
+        mqi::phsp_6d_ray<T> beamlet(beamlet_mean, beamlet_sigm, beamlet_divergence,
+                                    newBeamStartingPos);
 
-        return mqi::beamlet<T>(energy, beamlet);
+        return arena.emplace(std::move(energy), std::move(beamlet));
     }
 
     mqi::rangeshifter* characterize_rangeshifter(const mqi::dataset* ds, mqi::modality_type m) {
@@ -278,6 +308,14 @@ class gtr2 : public treatment_machine_ion<T> {
         // Creating beam source with log file information
         mqi::beamsource<T> beamsource;
 
+        // One pair of distributions per spot
+        size_t n_spots = 0;
+        for (auto& field : logfileData.beamInfo) {
+            for (auto& layer : field)
+                n_spots += layer.muCount.size();
+        }
+        beamsource.arena_ = std::make_shared<mqi::beamlet_arena<T>>(n_spots);
+
         for (int i = 0; i < logfileData.beamInfo.size(); i++) {
             for (int j = 0; j < logfileData.beamInfo[i].size(); j++) {
                 mqi::beam_module_ion::logspot logSpotInfo;
@@ -292,7 +330,8 @@ class gtr2 : public treatment_machine_ion<T> {
 
                     beamsource.append_beamlet_log(
                         this->characterize_beamlet(
-                            logSpotInfo, treatment_machine<T>::source_to_isocenter_mm_, rsuse),
+                            logSpotInfo, treatment_machine<T>::source_to_isocenter_mm_, rsuse,
+                            *beamsource.arena_),
                         this->characterize_history(logSpotInfo), pcoord);
                 }
             }
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <moqui/base/mqi_beamsource.hpp>
+#include <random>
+#include <vector>
+
+// History to beamlet lookup of beamsource against the std::map it replaced
+class BeamsourceTest : public ::testing::Test {
+   protected:
+    // Source with one beamlet per entry of histories and the former lookup table
+    void Build(const std::vector<size_t>& histories) {
+        size_t acc = 0;
+        for (size_t h : histories) {
+            acc += h;
+            cdf2beamlet_.insert(std::make_pair(acc, source_.total_beamlets()));
+            source_.append_beamlet(mqi::beamlet<float>(), h);
+        }
+    }
+
+    // Beamlet id of a history from the address of the returned reference
+    size_t BeamletId(size_t h) const {
+        const mqi::beamlet<float>* b = &source_.beamlet_of(h);
+        for (size_t i = 0; i < source_.total_beamlets(); ++i) {
+            if (b == &std::get<0>(source_[i]))
+                return i;
+        }
+        return source_.total_beamlets();
+    }
+
+    // Former lookup, std::map<size_t, size_t>::upper_bound
+    size_t MapBeamletId(size_t h) const { return cdf2beamlet_.upper_bound(h)->second; }
+
+    void ExpectSameAsMap() {
+        const size_t total = source_.total_histories();
+        for (size_t h = 0; h < total; ++h)
+            ASSERT_EQ(BeamletId(h), MapBeamletId(h)) << "history " << h;
+    }
+
+    mqi::beamsource<float> source_;
+    std::map<size_t, size_t> cdf2beamlet_;
+};
+
+TEST_F(BeamsourceTest, UpperIndex) {
+    EXPECT_EQ(mqi::beamsource<float>::upper_index(nullptr, 0, 5), 0u);
+    std::mt19937 rng(3);
+    for (size_t n = 1; n <= 65; ++n) {
+        std::vector<size_t> cdf(n);
+        size_t acc = 0;
+        for (auto& c : cdf) {
+            acc += 1 + rng() % 4;
+            c = acc;
+        }
+        for (size_t h = 0; h <= acc + 1; ++h) {
+            const size_t expected = std::upper_bound(cdf.begin(), cdf.end(), h) - cdf.begin();
+            ASSERT_EQ(mqi::beamsource<float>::upper_index(cdf.data(), n, h), expected)
+                << "n = " << n << ", h = " << h;
+        }
+    }
+}
+
+TEST_F(BeamsourceTest, SingleBeamlet) {
+    Build({5});
+    EXPECT_EQ(BeamletId(0), 0u);
+    EXPECT_EQ(BeamletId(4), 0u);
+    ExpectSameAsMap();
+}
+
+TEST_F(BeamsourceTest, SingleHistory) {
+    Build({1});
+    EXPECT_EQ(BeamletId(0), 0u);
+    ExpectSameAsMap();
+}
+
+TEST_F(BeamsourceTest, BoundariesAndEmptyBeamlets) {
+    ///< beamlets without histories at the start, in the middle and at the end
+    Build({0, 3, 0, 0, 1, 7, 0, 2, 0});
+    ASSERT_EQ(source_.total_histories(), 13u);
+
+    ///< first history goes to the first beamlet with histories
+    EXPECT_EQ(BeamletId(0), 1u);
+    ///< on and right before each cumulative boundary 3, 4, 11
+    EXPECT_EQ(BeamletId(2), 1u);
+    EXPECT_EQ(BeamletId(3), 4u);
+    EXPECT_EQ(BeamletId(4), 5u);
+    EXPECT_EQ(BeamletId(10), 5u);
+    EXPECT_EQ(BeamletId(11), 7u);
+    ///< last history goes to the last beamlet with histories, not the empty one after it
+    EXPECT_EQ(BeamletId(12), 7u);
+    ExpectSameAsMap();
+}
+
+TEST_F(BeamsourceTest, ManyBeamlets) {
+    std::mt19937 rng(17);
+    std::vector<size_t> histories(1000);
+    for (auto& h : histories)
+        h = (rng() % 5 == 0) ? 0 : rng() % 50;
+    Build(histories);
+    ExpectSameAsMap();
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <moqui/base/mqi_contour.hpp>
+#include <vector>
+
+// Scanline rasterizer of structure contours against the point-in-polygon test
+// (sol1_1) it replaced, applied to every voxel center of a slice
+class ContourTest : public ::testing::Test {
+   protected:
+    typedef std::vector<mqi::vec2<float>> contour_t;
+
+    void SetUp() override {
+        dim_ = mqi::vec3<mqi::ijk_t>(64, 48, 1);
+        x_pix_.resize(dim_.x + 1);
+        y_pix_.resize(dim_.y + 1);
+        for (int i = 0; i <= dim_.x; i++)
+            x_pix_[i] = -40.0f + i * dx_;
+        for (int j = 0; j <= dim_.y; j++)
+            y_pix_[j] = -30.0f + j * dy_;
+    }
+
+    // Even-odd ray casting of a point against one contour, as in tps_env::sol1_1
+    static bool Sol1_1(mqi::vec2<float> pos, const contour_t& contour) {
+        const int num_points = contour.size();
+        mqi::vec2<float> pos0, pos1;
+        int i, j, c = 0;
+        for (i = 0, j = num_points - 1; i < num_points; j = i++) {
+            pos0 = contour[i];
+            pos1 = contour[j];
+            if ((((pos0.y <= pos.y) && (pos.y < pos1.y)) ||
+                 ((pos1.y <= pos.y) && (pos.y < pos0.y))) &&
+                (pos.x < (pos1.x - pos0.x) * (pos.y - pos0.y) / (pos1.y - pos0.y) + pos0.x)) {
+                c = !c;
+            }
+        }
+        return c;
+    }
+
+    // Mask of the voxels whose center is inside an odd number of contours
+    std::vector<uint8_t> Reference(const std::vector<contour_t>& contours) const {
+        std::vector<uint8_t> mask(dim_.x * dim_.y, 0);
+        for (int j = 0; j < dim_.y; j++) {
+            for (int i = 0; i < dim_.x; i++) {
+                mqi::vec2<float> pos;
+                pos.x = x_pix_[i] + dx_ * 0.5;
+                pos.y = y_pix_[j] + dy_ * 0.5;
+                bool inside = false;
+                for (auto& contour : contours)
+                    inside ^= Sol1_1(pos, contour);
+                mask[j * dim_.x + i] = inside;
+            }
+        }
+        return mask;
+    }
+
+    std::vector<uint8_t> Rasterize(const std::vector<contour_t>& contours) const {
+        std::vector<uint8_t> mask(dim_.x * dim_.y, 0);
+        mqi::fill_contour_slice(mask.data(), contours, dim_, x_pix_.data(), y_pix_.data(), dx_,
+                                dy_);
+        return mask;
+    }
+
+    void ExpectSameMask(const std::vector<contour_t>& contours) const {
+        const std::vector<uint8_t> expected = Reference(contours);
+        const std::vector<uint8_t> mask = Rasterize(contours);
+        int n_inside = 0;
+        for (int j = 0; j < dim_.y; j++) {
+            for (int i = 0; i < dim_.x; i++) {
+                const int idx = j * dim_.x + i;
+                EXPECT_EQ(mask[idx], expected[idx]) << "voxel (" << i << ", " << j << ")";
+                n_inside += expected[idx];
+            }
+        }
+        EXPECT_GT(n_inside, 0);
+    }
+
+    // Regular polygon, slightly rotated so that no vertex is on a voxel center
+    static contour_t Polygon(float cx, float cy, float r, int n) {
+        contour_t c;
+        for (int k = 0; k < n; k++) {
+            const float a = 0.1f + 2.0f * float(M_PI) * k / n;
+            c.push_back(mqi::vec2<float>(cx + r * std::cos(a), cy + r * std::sin(a)));
+        }
+        return c;
+    }
+
+    static contour_t Rectangle(float x0, float y0, float x1, float y1) {
+        return contour_t{mqi::vec2<float>(x0, y0), mqi::vec2<float>(x1, y0),
+                         mqi::vec2<float>(x1, y1), mqi::vec2<float>(x0, y1)};
+    }
+
+    mqi::vec3<mqi::ijk_t> dim_;
+    std::vector<float> x_pix_;
+    std::vector<float> y_pix_;
+    const float dx_ = 1.25f;
+    const float dy_ = 1.25f;
+};
+
+TEST_F(ContourTest, SingleContour) {
+    ExpectSameMask({Polygon(0, 0, 22.3f, 40)});
+    ExpectSameMask({Polygon(-5, 3, 17.7f, 5)});
+}
+
+TEST_F(ContourTest, ConcaveContour) {
+    contour_t star;
+    for (int k = 0; k < 14; k++) {
+        const float r = (k % 2) ? 8.1f : 24.3f;
+        const float a = 0.05f + float(M_PI) * k / 7;
+        star.push_back(mqi::vec2<float>(-3 + r * std::cos(a), 1 + r * std::sin(a)));
+    }
+    ExpectSameMask({star});
+}
+
+TEST_F(ContourTest, NestedContours) {
+    ///< body with a hole and an island in the hole
+    ExpectSameMask({Polygon(0, 0, 27.1f, 64), Polygon(1, -1, 15.2f, 32), Polygon(2, 0, 5.3f, 16)});
+}
+
+TEST_F(ContourTest, OverlappingContours) {
+    ExpectSameMask({Polygon(-8, 0, 16.6f, 48), Polygon(8, 2, 14.4f, 48)});
+    ExpectSameMask(
+        {Rectangle(-30.1f, -20.3f, 10.2f, 5.6f), Rectangle(-10.4f, -10.7f, 20.9f, 22.1f)});
+}
+
+TEST_F(ContourTest, VerticesOnVoxelCenters) {
+    ///< voxel centers are -40 + 1.25 * (i + 0.5) and -30 + 1.25 * (j + 0.5)
+    auto xc = [&](int i) { return x_pix_[i] + dx_ * 0.5f; };
+    auto yc = [&](int j) { return y_pix_[j] + dy_ * 0.5f; };
+    ///< edges along rows and columns of centers, and diagonals through centers
+    ExpectSameMask({Rectangle(xc(10), yc(8), xc(40), yc(30))});
+    ExpectSameMask({contour_t{mqi::vec2<float>(xc(32), yc(2)), mqi::vec2<float>(xc(60), yc(24)),
+                              mqi::vec2<float>(xc(32), yc(46)), mqi::vec2<float>(xc(4), yc(24))}});
+    ///< nested and touching at centers
+    ExpectSameMask({Rectangle(xc(5), yc(5), xc(50), yc(40)),
+                    Rectangle(xc(10), yc(10), xc(30), yc(40)),
+                    contour_t{mqi::vec2<float>(xc(40), yc(10)), mqi::vec2<float>(xc(50), yc(20)),
+                              mqi::vec2<float>(xc(40), yc(30))}});
+}
+
+TEST_F(ContourTest, ContourBeyondTheGrid) {
+    ExpectSameMask({Rectangle(-100, -100, 100, 100), Polygon(60, 0, 30.5f, 24)});
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <moqui/base/mqi_grid3d.hpp>
+#include <random>
+#include <vector>
+
+// grid3d::index against the linear scan over all cells it replaced
+template <typename R>
+class Grid3dIndexTest : public ::testing::Test {
+   protected:
+    // Voxel index along one axis as the former linear scan found it
+    static mqi::ijk_t ScanIndex(const std::vector<R>& e, R p, R dir) {
+        const mqi::ijk_t n = e.size() - 1;
+        mqi::ijk_t idx = -1;
+        for (mqi::ijk_t ind = 0; ind < n; ind++) {
+            if (mqi::mqi_abs(e[ind] - p) < mqi::geometry_tolerance) {
+                idx = (dir < 0) ? ind - 1 : ind;
+                break;
+            } else if (mqi::mqi_abs(e[ind + 1] - p) < mqi::geometry_tolerance) {
+                idx = (dir > 0) ? ind + 1 : ind;
+                break;
+            } else if (e[ind] - p < 0 && e[ind + 1] - p > 0) {
+                idx = ind;
+                break;
+            } else {
+                idx = -1;
+            }
+        }
+        return idx;
+    }
+
+    // Points on, next to and between edges, within and beyond geometry_tolerance
+    static std::vector<R> Probes(const std::vector<R>& e) {
+        const R tol = mqi::geometry_tolerance;
+        std::vector<R> p;
+        for (size_t i = 0; i < e.size(); ++i) {
+            for (R offset : {R(0), R(0.5) * tol, R(-0.5) * tol, R(0.99) * tol, R(-0.99) * tol,
+                             R(1.5) * tol, R(-1.5) * tol, R(0.25), R(-0.25)}) {
+                p.push_back(e[i] + offset);
+            }
+            if (i + 1 < e.size())
+                p.push_back((e[i] + e[i + 1]) / 2);
+        }
+        std::mt19937 rng(7);
+        const auto range = std::minmax_element(e.begin(), e.end());
+        std::uniform_real_distribution<R> uniform(*range.first - 5, *range.second + 5);
+        for (int i = 0; i < 1000; ++i)
+            p.push_back(uniform(rng));
+        return p;
+    }
+
+    // Compares index() with the scan along x for every probe and direction.
+    // y and z are a single cell around 0.
+    static void ExpectSameAsScan(const std::vector<R>& xe) {
+        const R ye[2] = {-1, 1};
+        const R ze[2] = {-1, 1};
+        mqi::grid3d<mqi::density_t, R> geo(xe.data(), xe.size(), ye, 2, ze, 2);
+        for (R x : Probes(xe)) {
+            for (R d : {R(1), R(-1), R(0)}) {
+                mqi::vec3<R> pos(x, 0, 0);
+                mqi::vec3<R> dir(d, 0, 0);
+                ASSERT_EQ(geo.index(pos, dir).x, ScanIndex(xe, x, d))
+                    << "x = " << x << ", dir = " << d;
+            }
+        }
+    }
+};
+
+typedef ::testing::Types<float, double> Grid3dTypes;
+TYPED_TEST_SUITE(Grid3dIndexTest, Grid3dTypes);
+
+TYPED_TEST(Grid3dIndexTest, UniformAxis) {
+    typedef TypeParam R;
+    std::vector<R> xe(257);
+    for (size_t i = 0; i < xe.size(); ++i)
+        xe[i] = R(-256.4) + i * R(1.953125);
+    this->ExpectSameAsScan(xe);
+}
+
+TYPED_TEST(Grid3dIndexTest, NonUniformAxis) {
+    typedef TypeParam R;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<R> spacing(0.01, 4.0);
+    std::vector<R> xe(200);
+    xe[0] = -150;
+    for (size_t i = 1; i < xe.size(); ++i)
+        xe[i] = xe[i - 1] + spacing(rng);
+    this->ExpectSameAsScan(xe);
+}
+
+TYPED_TEST(Grid3dIndexTest, SingleCellAxis) {
+    typedef TypeParam R;
+    this->ExpectSameAsScan(std::vector<R>{-2, 3});
+}
+
+TYPED_TEST(Grid3dIndexTest, DescendingAxis) {
+    typedef TypeParam R;
+    std::vector<R> xe(50);
+    for (size_t i = 0; i < xe.size(); ++i)
+        xe[i] = R(20) - i * R(0.8);
+    this->ExpectSameAsScan(xe);
+}
+
+TYPED_TEST(Grid3dIndexTest, UnorderedAxis) {
+    typedef TypeParam R;
+    this->ExpectSameAsScan(std::vector<R>{0, 2, 1, 4, 3, 3, 8, 5, 9});
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <map>
+#include <moqui/kernel_functions/mqi_transport.hpp>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Scorer hash table shared by the CPU transport workers (insert_hashtable)
+class HashtableTest : public ::testing::Test {
+   protected:
+    struct record_t {
+        mqi::key_t key1;
+        mqi::key_t key2;
+        double value;
+    };
+    typedef std::map<std::pair<mqi::key_t, mqi::key_t>, double> pairs_t;
+
+    // Records of one worker. Values are small integers, so that the sums are
+    // exact whatever the order of the additions.
+    static std::vector<record_t> Records(uint32_t seed, size_t n, mqi::key_t n_key1,
+                                         mqi::key_t n_key2) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<mqi::key_t> key1(0, n_key1 - 1);
+        std::uniform_int_distribution<mqi::key_t> key2(0, n_key2 - 1);
+        std::uniform_int_distribution<int> value(1, 8);
+        std::vector<record_t> records(n);
+        for (auto& r : records) {
+            r.key1 = key1(rng);
+            r.key2 = n_key2 ? key2(rng) : mqi::empty_pair;
+            r.value = value(rng);
+        }
+        return records;
+    }
+
+    static void Insert(mqi::key_value* table, const std::vector<record_t>& records,
+                       uint64_t max_capacity) {
+        for (auto& r : records)
+            mc::insert_hashtable<float>(table, r.key1, r.key2, r.value, 0, max_capacity);
+    }
+
+    // Every worker inserts its records into one table at the same time
+    static std::vector<mqi::key_value> InsertConcurrently(
+        const std::vector<std::vector<record_t>>& records, uint64_t max_capacity) {
+        std::vector<mqi::key_value> table(max_capacity);
+        mqi::init_table(table.data(), max_capacity);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> workers;
+        for (auto& r : records) {
+            workers.emplace_back([&, rec = &r]() {
+                while (!go.load())
+                    std::this_thread::yield();
+                Insert(table.data(), *rec, max_capacity);
+            });
+        }
+        go = true;
+        for (auto& w : workers)
+            w.join();
+        return table;
+    }
+
+    static std::vector<mqi::key_value> InsertSerially(
+        const std::vector<std::vector<record_t>>& records, uint64_t max_capacity) {
+        std::vector<mqi::key_value> table(max_capacity);
+        mqi::init_table(table.data(), max_capacity);
+        for (auto& r : records)
+            Insert(table.data(), r, max_capacity);
+        return table;
+    }
+
+    // Pairs of the table, each of which must be in exactly one slot.
+    // A slot is either empty or has both keys.
+    static pairs_t Pairs(const std::vector<mqi::key_value>& table) {
+        pairs_t pairs;
+        for (size_t s = 0; s < table.size(); ++s) {
+            const mqi::key_value& kv = table[s];
+            if (kv.key1 == mqi::empty_pair) {
+                EXPECT_EQ(kv.key2, mqi::empty_pair) << "slot " << s;
+                EXPECT_EQ(kv.value, 0.0) << "slot " << s;
+                continue;
+            }
+            EXPECT_NE(kv.key2, mqi::empty_pair) << "slot " << s;
+            EXPECT_TRUE(pairs.emplace(std::make_pair(kv.key1, kv.key2), kv.value).second)
+                << "(" << kv.key1 << ", " << kv.key2 << ") in more than one slot";
+        }
+        return pairs;
+    }
+
+    // Sums of the records per pair, key2 of empty_pair is stored as 0
+    static pairs_t Expected(const std::vector<std::vector<record_t>>& records) {
+        pairs_t pairs;
+        for (auto& rec : records) {
+            for (auto& r : rec)
+                pairs[std::make_pair(r.key1, r.key2 == mqi::empty_pair ? 0 : r.key2)] += r.value;
+        }
+        return pairs;
+    }
+};
+
+TEST_F(HashtableTest, CollidingPairsFromManyThreads) {
+    ///< Dij scoring: key1 is the voxel and key2 the spot, 3000 pairs in 4096 slots
+    const uint64_t max_capacity = 4096;
+    for (int n_threads : {2, 4, 8, 16}) {
+        std::vector<std::vector<record_t>> records;
+        for (int t = 0; t < n_threads; ++t)
+            records.push_back(Records(100 + t, 20000, 150, 20));
+        const pairs_t expected = Expected(records);
+
+        for (int run = 0; run < 5; ++run) {
+            const std::vector<mqi::key_value> table = InsertConcurrently(records, max_capacity);
+            EXPECT_EQ(Pairs(table), expected) << n_threads << " threads, run " << run;
+        }
+        EXPECT_EQ(Pairs(InsertSerially(records, max_capacity)), expected);
+
+        ///< the pairs must have collided, otherwise probing is not tested
+        const std::vector<mqi::key_value> table = InsertSerially(records, max_capacity);
+        int n_probed = 0;
+        for (size_t s = 0; s < table.size(); ++s) {
+            if (table[s].key1 != mqi::empty_pair &&
+                mc::hash_fun(table[s].key1, table[s].key2, max_capacity) != s)
+                ++n_probed;
+        }
+        EXPECT_GT(n_probed, 0);
+    }
+}
+
+TEST_F(HashtableTest, VoxelKeysFromManyThreads) {
+    ///< key2 of empty_pair: key1 is the slot and key2 is stored as 0
+    const uint64_t max_capacity = 512;
+    for (int n_threads : {2, 4, 8, 16}) {
+        std::vector<std::vector<record_t>> records;
+        for (int t = 0; t < n_threads; ++t)
+            records.push_back(Records(200 + t, 20000, 64, 0));
+        const pairs_t expected = Expected(records);
+
+        for (int run = 0; run < 5; ++run) {
+            const std::vector<mqi::key_value> table = InsertConcurrently(records, max_capacity);
+            EXPECT_EQ(Pairs(table), expected) << n_threads << " threads, run " << run;
+            for (auto& p : Pairs(table))
+                EXPECT_EQ(table[p.first.first].key1, p.first.first);
+        }
+        EXPECT_EQ(Pairs(InsertSerially(records, max_capacity)), expected);
+    }
+}
+
+TEST_F(HashtableTest, NonPositiveValuesAreNotInserted) {
+    std::vector<mqi::key_value> table(16);
+    mqi::init_table(table.data(), table.size());
+    mc::insert_hashtable<float>(table.data(), 3, 5, 0.0, 0, table.size());
+    mc::insert_hashtable<float>(table.data(), 4, mqi::empty_pair, -1.0, 0, table.size());
+    EXPECT_TRUE(Pairs(table).empty());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
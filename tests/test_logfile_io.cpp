@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <moqui/base/mqi_logfile_io.hpp>
+#include <string>
+#include <vector>
+
+// Delivery log reader and its binary cache
+class LogfileIoTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        test_dir_ = std::filesystem::temp_directory_path() / "moqui_logfile_test";
+        std::filesystem::remove_all(test_dir_);
+        std::filesystem::create_directories(test_dir_);
+        cache_file_ = (test_dir_ / "logfile_cache.bin").string();
+
+        WriteFile("1_150MeV.csv", "0.0,1.5,-2.25,100,0.1,3,4.5,250,0.2,-7.75,0,40");
+        WriteFile("2_148.5MeV.csv", "0.0,10,20,1000,0.1,-10,-20,2000\n");
+        WriteFile("3_70.csv", "");
+        for (auto& name : {"1_150MeV.csv", "2_148.5MeV.csv", "3_70.csv"})
+            files_.push_back(test_dir_ / name);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(test_dir_, ec);
+    }
+
+    void WriteFile(const std::string& name, const std::string& content) {
+        std::ofstream fs(test_dir_ / name, std::ios::binary | std::ios::trunc);
+        fs << content;
+    }
+
+    static void ExpectSameLayers(const std::vector<mqi::logfile_t>& a,
+                                 const std::vector<mqi::logfile_t>& b) {
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            EXPECT_EQ(a[i].posX, b[i].posX);
+            EXPECT_EQ(a[i].posY, b[i].posY);
+            EXPECT_EQ(a[i].muCount, b[i].muCount);
+        }
+    }
+
+    std::filesystem::path test_dir_;
+    std::string cache_file_;
+    std::vector<std::filesystem::path> files_;
+    const float particles_per_history_ = 0.5f;
+};
+
+TEST_F(LogfileIoTest, ReadsLayers) {
+    std::vector<mqi::logfile_t> layers;
+    std::vector<float> energies;
+    mqi::io::read_log_field(files_, particles_per_history_, layers, energies);
+
+    ASSERT_EQ(layers.size(), 3u);
+    EXPECT_EQ(energies, (std::vector<float>{150.0f, 148.5f, 70.0f}));
+    EXPECT_EQ(layers[0].posX, (std::vector<float>{1.5f, 3.0f, -7.75f}));
+    EXPECT_EQ(layers[0].posY, (std::vector<float>{-2.25f, 4.5f, 0.0f}));
+    EXPECT_EQ(layers[0].muCount, (std::vector<int>{50, 125, 20}));
+    EXPECT_EQ(layers[1].muCount, (std::vector<int>{500, 1000}));
+    EXPECT_TRUE(layers[2].posX.empty());
+}
+
+TEST_F(LogfileIoTest, CacheRoundTrip) {
+    std::vector<mqi::logfile_t> layers;
+    std::vector<float> energies;
+    mqi::io::read_log_field(files_, particles_per_history_, layers, energies);
+
+    const uint64_t hash = mqi::io::hash_log_files(files_, particles_per_history_);
+    ASSERT_TRUE(mqi::io::write_log_cache(cache_file_, hash, layers, energies));
+    EXPECT_FALSE(std::filesystem::exists(cache_file_ + ".tmp"));
+
+    std::vector<mqi::logfile_t> cached_layers;
+    std::vector<float> cached_energies;
+    ASSERT_TRUE(mqi::io::read_log_cache(cache_file_, hash, cached_layers, cached_energies));
+    EXPECT_EQ(cached_energies, energies);
+    ExpectSameLayers(cached_layers, layers);
+}
+
+TEST_F(LogfileIoTest, KeyFollowsFilesAndScale) {
+    const uint64_t hash = mqi::io::hash_log_files(files_, particles_per_history_);
+    EXPECT_EQ(mqi::io::hash_log_files(files_, particles_per_history_), hash);
+    EXPECT_NE(mqi::io::hash_log_files(files_, 2 * particles_per_history_), hash);
+
+    ///< same size, later modification time
+    auto t = std::filesystem::last_write_time(files_[1]);
+    std::filesystem::last_write_time(files_[1], t + std::chrono::seconds(5));
+    const uint64_t touched = mqi::io::hash_log_files(files_, particles_per_history_);
+    EXPECT_NE(touched, hash);
+
+    ///< appended record
+    WriteFile("2_148.5MeV.csv", "0.0,10,20,1000,0.1,-10,-20,2000,0.2,0,0,1\n");
+    EXPECT_NE(mqi::io::hash_log_files(files_, particles_per_history_), touched);
+}
+
+TEST_F(LogfileIoTest, StaleCacheIsRejected) {
+    std::vector<mqi::logfile_t> layers;
+    std::vector<float> energies;
+    mqi::io::read_log_field(files_, particles_per_history_, layers, energies);
+    const uint64_t hash = mqi::io::hash_log_files(files_, particles_per_history_);
+    ASSERT_TRUE(mqi::io::write_log_cache(cache_file_, hash, layers, energies));
+
+    WriteFile("1_150MeV.csv", "0.0,1.5,-2.25,100");
+    const uint64_t new_hash = mqi::io::hash_log_files(files_, particles_per_history_);
+    ASSERT_NE(new_hash, hash);
+
+    std::vector<mqi::logfile_t> cached_layers;
+    std::vector<float> cached_energies;
+    EXPECT_FALSE(mqi::io::read_log_cache(cache_file_, new_hash, cached_layers, cached_energies));
+}
+
+TEST_F(LogfileIoTest, MalformedCacheIsRejected) {
+    std::vector<mqi::logfile_t> layers;
+    std::vector<float> energies;
+    mqi::io::read_log_field(files_, particles_per_history_, layers, energies);
+    const uint64_t hash = mqi::io::hash_log_files(files_, particles_per_history_);
+    ASSERT_TRUE(mqi::io::write_log_cache(cache_file_, hash, layers, energies));
+    const uintmax_t size = std::filesystem::file_size(cache_file_);
+
+    std::vector<mqi::logfile_t> cached_layers;
+    std::vector<float> cached_energies;
+    EXPECT_FALSE(mqi::io::read_log_cache(cache_file_ + ".missing", hash, cached_layers,
+                                         cached_energies));
+
+    ///< truncated in the layer data, in the layer table and in the header
+    for (uintmax_t truncated : {size - 4, uintmax_t(sizeof(mqi::io::log_cache_header) + 8),
+                                uintmax_t(sizeof(mqi::io::log_cache_header) - 1), uintmax_t(0)}) {
+        std::filesystem::resize_file(cache_file_, truncated);
+        EXPECT_FALSE(mqi::io::read_log_cache(cache_file_, hash, cached_layers, cached_energies))
+            << "size " << truncated;
+    }
+
+    ///< trailing bytes
+    ASSERT_TRUE(mqi::io::write_log_cache(cache_file_, hash, layers, energies));
+    {
+        std::ofstream fs(cache_file_, std::ios::binary | std::ios::app);
+        fs.put(0);
+    }
+    EXPECT_FALSE(mqi::io::read_log_cache(cache_file_, hash, cached_layers, cached_energies));
+
+    ///< wrong magic
+    ASSERT_TRUE(mqi::io::write_log_cache(cache_file_, hash, layers, energies));
+    {
+        std::fstream fs(cache_file_, std::ios::binary | std::ios::in | std::ios::out);
+        fs.put('X');
+    }
+    EXPECT_FALSE(mqi::io::read_log_cache(cache_file_, hash, cached_layers, cached_energies));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
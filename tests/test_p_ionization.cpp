@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <moqui/base/mqi_fippel_physics.hpp>
+#include <moqui/base/materials/mqi_material.hpp>
+#include <vector>
+
+// Range to energy bin table of p_ionization_tabulated and the energy loss using it
+
+TEST(PIonizationTest, RangeGridCoversRangeSteps) {
+    EXPECT_EQ(mqi::range_steps_bins,
+              uint16_t(std::floor(mqi::range_steps[599] / mqi::range_steps_dR)) + 1);
+    EXPECT_EQ(sizeof(mqi::range_steps_index) / sizeof(mqi::range_steps_index[0]),
+              size_t(mqi::range_steps_bins));
+}
+
+TEST(PIonizationTest, RangeIndexMatchesRangeSteps) {
+    ///< largest energy bin n (n < 599) with range_steps[n] <= k * dR, 0 if there is none
+    for (uint16_t k = 0; k < mqi::range_steps_bins; ++k) {
+        const float r = k * mqi::range_steps_dR;
+        uint16_t n = 0;
+        for (uint16_t i = 0; i < 599; ++i) {
+            if (mqi::range_steps[i] <= r)
+                n = i;
+        }
+        ASSERT_EQ(mqi::range_steps_index[k], n) << "range bin " << k;
+    }
+}
+
+// Energy loss with the backward scan over range_steps that the range grid replaced
+static float ScanEnergyLoss(mqi::p_ionization_tabulated<float>& p_ion,
+                            const mqi::relativistic_quantities<float>& rel,
+                            mqi::material_t<float>& mat, const float step_length,
+                            mqi::mqi_rng* rng) {
+    const float Ei = 0.1;
+    const float E_step = 0.5;
+    const float* r_steps = mqi::range_steps;
+    float length_in_water = step_length * mat.stopping_power_ratio(rel.Ek) * mat.rho_mass /
+                            mqi::physics_constants<float>().water_density;
+    uint16_t n = uint16_t((rel.Ek - Ei) / E_step);
+    float x0 = Ei + n * E_step;
+    float x1 = x0 + E_step;
+    if (x0 > rel.Ek)
+        n -= 1;
+    if (x1 < rel.Ek)
+        n += 1;
+
+    float r = mqi::intpl1d(rel.Ek, x0, x1, r_steps[n], r_steps[n + 1]);
+    if (r < length_in_water)
+        return rel.Ek;
+    r -= length_in_water;
+    do {
+        if (r >= r_steps[n])
+            break;
+    } while (--n > 0);
+    x0 = Ei + n * E_step;
+    x1 = x0 + E_step;
+    float dE_mean = rel.Ek - mqi::intpl1d(r, r_steps[n], r_steps[n + 1], x0, x1);
+    float dE_var = p_ion.energy_straggling(rel, mat, length_in_water);
+    float ret = mqi::mqi_normal(rng, dE_mean, mqi::mqi_sqrt(dE_var));
+    if (ret < 0)
+        ret *= -1.0;
+    return ret;
+}
+
+TEST(PIonizationTest, EnergyLossMatchesBackwardScan) {
+    mqi::fippel_physics<float> fippel;
+    mqi::h2o_t<float> water;
+    const float Mp = mqi::physics_constants<float>().Mp;
+    mqi::mqi_rng rng(2024, 1);
+    mqi::mqi_rng scan_rng(2024, 1);
+    uint64_t history = 0;
+    for (float rho_mass : {0.0012e-3f, 1.0e-3f, 1.85e-3f}) {
+        water.rho_mass = rho_mass;
+        for (float Ek = 1.0f; Ek < 299.5f; Ek += 0.173f) {
+            for (float step : {0.001f, 0.05f, 0.25f, 1.0f, 3.7f, 20.0f, 400.0f}) {
+                mqi::relativistic_quantities<float> rel(Ek, Mp);
+                rng.set_history(history);
+                scan_rng.set_history(history);
+                ++history;
+                const float dE = fippel.p_ion.energy_loss(rel, water, step, &rng);
+                const float expected = ScanEnergyLoss(fippel.p_ion, rel, water, step, &scan_rng);
+                ASSERT_EQ(dE, expected)
+                    << "Ek = " << Ek << ", step = " << step << ", rho = " << rho_mass;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <moqui/kernel_functions/mqi_transport.hpp>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Private per-thread accumulators of a scorer (ThreadLocalScoring) and their reduction
+class ScorerTest : public ::testing::Test {
+   protected:
+    static constexpr uint32_t n_voxels_ = 10007;
+    static constexpr uint32_t n_buffers_ = 7;
+
+    // Fill the private buffers with values of very different magnitudes,
+    // so that a change of the summation order changes the result
+    static void FillThreadData(mqi::scorer<float>& scr) {
+        std::mt19937_64 rng(1234);
+        std::uniform_real_distribution<double> exponent(-12.0, 3.0);
+        std::uniform_int_distribution<int> hit(0, 3);
+        for (uint32_t t = 0; t < scr.n_thread_data_; ++t) {
+            for (uint32_t v = 0; v < scr.max_capacity_; ++v) {
+                scr.thread_data_[t][v] = hit(rng) == 0 ? 0.0 : std::pow(10.0, exponent(rng));
+            }
+        }
+    }
+
+    // Reduce the buffers into the dense storage with n_workers threads
+    static std::vector<double> Reduce(mqi::scorer<float>& scr, uint32_t n_workers) {
+        std::memset(scr.dense_data_, 0, sizeof(double) * scr.max_capacity_);
+        std::vector<std::thread> workers;
+        for (uint32_t i = 0; i < n_workers; ++i) {
+            workers.emplace_back(mc::reduce_thread_data<float>, &scr, scr.n_thread_data_,
+                                 n_workers, i);
+        }
+        for (auto& w : workers)
+            w.join();
+        return std::vector<double>(scr.dense_data_, scr.dense_data_ + scr.max_capacity_);
+    }
+
+    static void ExpectBitIdentical(const std::vector<double>& a, const std::vector<double>& b) {
+        ASSERT_EQ(a.size(), b.size());
+        EXPECT_EQ(std::memcmp(a.data(), b.data(), sizeof(double) * a.size()), 0);
+    }
+};
+
+TEST_F(ScorerTest, ThreadDataBytes) {
+    mqi::scorer<float> scr("dose", 512 * 512 * 300, nullptr);
+    EXPECT_EQ(scr.thread_data_bytes(64), size_t(64) * 512 * 512 * 300 * sizeof(double));
+}
+
+TEST_F(ScorerTest, ReductionIsReproducible) {
+    mqi::scorer<float> scr("dose", n_voxels_, nullptr);
+    scr.dense_data_ = new double[n_voxels_]();
+    scr.allocate_thread_data(n_buffers_);
+
+    FillThreadData(scr);
+    const std::vector<double> first = Reduce(scr, n_buffers_);
+    for (int run = 0; run < 10; ++run) {
+        FillThreadData(scr);
+        ExpectBitIdentical(first, Reduce(scr, n_buffers_));
+    }
+}
+
+TEST_F(ScorerTest, ReductionDoesNotDependOnReductionWorkers) {
+    mqi::scorer<float> scr("dose", n_voxels_, nullptr);
+    scr.dense_data_ = new double[n_voxels_]();
+    scr.allocate_thread_data(n_buffers_);
+
+    FillThreadData(scr);
+    const std::vector<double> serial = Reduce(scr, 1);
+    for (uint32_t n_workers : {2u, 3u, 8u, 13u}) {
+        FillThreadData(scr);
+        ExpectBitIdentical(serial, Reduce(scr, n_workers));
+    }
+}
+
+TEST_F(ScorerTest, ReductionSumsPairwiseAndClearsBuffers) {
+    mqi::scorer<float> scr("dose", n_voxels_, nullptr);
+    scr.dense_data_ = new double[n_voxels_]();
+    scr.allocate_thread_data(n_buffers_);
+
+    FillThreadData(scr);
+    // pairwise tree order of reduce_thread_data for 7 buffers: ((0+1)+(2+3))+((4+5)+6)
+    std::vector<double> expected(n_voxels_);
+    for (uint32_t v = 0; v < n_voxels_; ++v) {
+        double** b = scr.thread_data_;
+        expected[v] = ((b[0][v] + b[1][v]) + (b[2][v] + b[3][v])) + ((b[4][v] + b[5][v]) + b[6][v]);
+    }
+    ExpectBitIdentical(expected, Reduce(scr, 4));
+
+    for (uint32_t t = 0; t < n_buffers_; ++t) {
+        for (uint32_t v = 0; v < n_voxels_; ++v) {
+            ASSERT_EQ(scr.thread_data_[t][v], 0.0);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
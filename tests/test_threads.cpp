@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <moqui/base/mqi_threads.hpp>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Spot tasks and the work-stealing queue of the PER_SPOT CPU transport
+class ThreadsTest : public ::testing::Test {
+   protected:
+    // scorer offsets of a batch: runs of very different lengths, one per spot
+    static std::vector<uint32_t> SpotOffsets(uint32_t n_spots, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<uint32_t> offsets;
+        for (uint32_t s = 0; s < n_spots; ++s) {
+            const uint32_t n = (rng() % 3 == 0) ? 1 + rng() % 5000 : 1 + rng() % 50;
+            offsets.insert(offsets.end(), n, s * 1000);
+        }
+        return offsets;
+    }
+
+    // every task is within one spot, at most chunk long, and the tasks tile [0, n) in order
+    static void ExpectSpotTasks(const std::vector<mqi::history_task>& tasks,
+                                const std::vector<uint32_t>& offsets, uint32_t chunk) {
+        uint32_t next = 0;
+        for (auto& t : tasks) {
+            ASSERT_EQ(t.first, next);
+            ASSERT_LT(t.first, t.last);
+            ASSERT_LE(t.last - t.first, std::max(chunk, 1u));
+            for (uint32_t h = t.first; h < t.last; ++h)
+                ASSERT_EQ(offsets[h], offsets[t.first]) << "task [" << t.first << ", " << t.last
+                                                        << ") mixes spots";
+            next = t.last;
+        }
+        EXPECT_EQ(next, offsets.size());
+    }
+
+    // pops every task of a queue with n_threads concurrent workers
+    // \return number of times each history came out
+    static std::vector<int> PopAll(mqi::task_queue& queue, uint32_t n_threads, uint32_t n) {
+        std::vector<std::atomic<int>> count(n);
+        std::vector<std::thread> workers;
+        for (uint32_t w = 0; w < n_threads; ++w) {
+            workers.emplace_back([&, w]() {
+                mqi::history_task task;
+                while (queue.pop(w, task)) {
+                    for (uint32_t h = task.first; h < task.last; ++h)
+                        count[h].fetch_add(1, std::memory_order_relaxed);
+                    ///< slow down worker 0 so that the others steal its tasks
+                    if (w == 0)
+                        std::this_thread::yield();
+                }
+            });
+        }
+        for (auto& t : workers)
+            t.join();
+        return std::vector<int>(count.begin(), count.end());
+    }
+};
+
+TEST_F(ThreadsTest, TasksNeverMixSpots) {
+    const std::vector<uint32_t> offsets = SpotOffsets(300, 5);
+    for (uint32_t chunk : {0u, 1u, 7u, 256u, 100000u}) {
+        ExpectSpotTasks(mqi::make_spot_tasks(offsets.data(), offsets.size(), chunk), offsets,
+                        chunk);
+    }
+}
+
+TEST_F(ThreadsTest, SameOffsetOfSeparateRunsStaysSeparate) {
+    ///< a spot repeated later in the batch is a new run
+    const std::vector<uint32_t> offsets = {4, 4, 8, 8, 8, 4, 4};
+    const std::vector<mqi::history_task> tasks = mqi::make_spot_tasks(offsets.data(), 7, 2);
+    ASSERT_EQ(tasks.size(), 4u);
+    EXPECT_EQ(tasks[0].last, 2u);
+    EXPECT_EQ(tasks[1].last, 4u);
+    EXPECT_EQ(tasks[2].last, 5u);
+    EXPECT_EQ(tasks[3].last, 7u);
+}
+
+TEST_F(ThreadsTest, EveryHistoryOnceWithConcurrentWorkers) {
+    const std::vector<uint32_t> offsets = SpotOffsets(500, 9);
+    const uint32_t n = offsets.size();
+    const std::vector<mqi::history_task> tasks = mqi::make_spot_tasks(offsets.data(), n, 64);
+    for (uint32_t n_threads : {2u, 4u, 8u, 16u}) {
+        for (int run = 0; run < 5; ++run) {
+            mqi::task_queue queue(tasks, n_threads);
+            const std::vector<int> count = PopAll(queue, n_threads, n);
+            for (uint32_t h = 0; h < n; ++h)
+                ASSERT_EQ(count[h], 1) << "history " << h << " with " << n_threads << " threads";
+        }
+    }
+}
+
+TEST_F(ThreadsTest, IdleWorkersStealEverything) {
+    ///< only half of the workers of the queue run, so they must steal the other half
+    const std::vector<uint32_t> offsets = SpotOffsets(200, 13);
+    const uint32_t n = offsets.size();
+    mqi::task_queue queue(mqi::make_spot_tasks(offsets.data(), n, 32), 8);
+    const std::vector<int> count = PopAll(queue, 4, n);
+    for (uint32_t h = 0; h < n; ++h)
+        ASSERT_EQ(count[h], 1) << "history " << h;
+}
+
+TEST_F(ThreadsTest, OwnTasksFromTheFrontStolenFromTheBack) {
+    std::vector<mqi::history_task> tasks;
+    for (uint32_t i = 0; i < 4; ++i)
+        tasks.push_back({i * 10, i * 10 + 10});
+    ///< worker 0 gets [0, 20), worker 1 gets [20, 40)
+    mqi::task_queue queue(tasks, 2);
+    mqi::history_task task;
+    ASSERT_TRUE(queue.pop(1, task));
+    EXPECT_EQ(task.first, 20u);
+    ASSERT_TRUE(queue.pop(1, task));
+    EXPECT_EQ(task.first, 30u);
+    ASSERT_TRUE(queue.pop(1, task));
+    EXPECT_EQ(task.first, 10u);
+    ASSERT_TRUE(queue.pop(0, task));
+    EXPECT_EQ(task.first, 0u);
+    EXPECT_FALSE(queue.pop(0, task));
+    EXPECT_FALSE(queue.pop(1, task));
+}
+
+TEST_F(ThreadsTest, ZeroOrOneWorker) {
+    const std::vector<uint32_t> offsets = SpotOffsets(50, 21);
+    const std::vector<mqi::history_task> tasks =
+        mqi::make_spot_tasks(offsets.data(), offsets.size(), 16);
+    for (uint32_t n_workers : {0u, 1u}) {
+        mqi::task_queue queue(tasks, n_workers);
+        mqi::history_task task;
+        for (auto& t : tasks) {
+            ASSERT_TRUE(queue.pop(0, task));
+            EXPECT_EQ(task.first, t.first);
+            EXPECT_EQ(task.last, t.last);
+        }
+        EXPECT_FALSE(queue.pop(0, task));
+    }
+}
+
+TEST_F(ThreadsTest, EmptyBatch) {
+    EXPECT_TRUE(mqi::make_spot_tasks(nullptr, 0, 16).empty());
+    for (uint32_t n_workers : {0u, 1u, 4u}) {
+        mqi::task_queue queue(std::vector<mqi::history_task>(), n_workers);
+        mqi::history_task task;
+        for (uint32_t w = 0; w < std::max(n_workers, 1u); ++w)
+            EXPECT_FALSE(queue.pop(w, task));
+    }
+    mqi::task_queue queue(std::vector<mqi::history_task>(), 4);
+    EXPECT_EQ(PopAll(queue, 4, 0).size(), 0u);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}